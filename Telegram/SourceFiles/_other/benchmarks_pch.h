@@ -0,0 +1,50 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+
+#include <QtCore/QObject>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+#include <QtCore/QSize>
+#include <QtCore/QRect>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+#include <QtGui/QTransform>
+
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <atomic>
+#include <optional>
+
+#include <range/v3/all.hpp>
+
+// Redefine Ensures/Expects by our own assertions.
+#include "base/assertion.h"
+
+#include <gsl/gsl>
+#include <rpl/rpl.h>
+#include <crl/crl.h>
+
+#include "base/variant.h"
+#include "base/optional.h"
+#include "base/algorithm.h"
+#include "base/flat_set.h"
+#include "base/flat_map.h"
+#include "base/weak_ptr.h"
+
+#include "base/basic_types.h"
+#include "base/debug_log.h"
+
+#include "scheme.h"
+#include "data/data_msg_id.h"
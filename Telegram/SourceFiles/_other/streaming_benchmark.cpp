@@ -0,0 +1,496 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "media/streaming/media_streaming_reader.h"
+#include "media/streaming/media_streaming_loader.h"
+#include "storage/cache/storage_cache_database.h"
+#include "storage/storage_encryption.h"
+#include "ui/main_queue_processor.h"
+#include "base/concurrent_timer.h"
+#include "base/integration.h"
+#include "base/random.h"
+#include "base/call_delayed.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+
+#include <iostream>
+#include <random>
+#include <thread>
+
+// Headless benchmark of Media::Streaming::Reader slice cache.
+//
+// Replays an access trace against a Reader that loads parts from a local
+// stand-in Loader with a fixed latency and keeps slices in a temporary
+// cache database. The first run starts with an empty cache, the next ones
+// reuse it, like when a video is watched again.
+//
+// Usage: StreamingBenchmark [--trace <file>] [--size <megabytes>]
+//   [--latency <ms>] [--runs <count>] [--limit <megabytes>] [--verbose]
+//
+// A trace file has one access per line: "read <offset> <size>", and
+// a "header" line where the header is parsed and Reader::headerDone()
+// is called. Without a trace, a playback with seeks is generated.
+
+namespace {
+
+using namespace Media::Streaming;
+
+constexpr auto kDefaultSize = int64(256 * 1024 * 1024);
+constexpr auto kDefaultLatency = crl::time(50);
+constexpr auto kDefaultRuns = 2;
+constexpr auto kReadSize = 32 * 1024;
+constexpr auto kHeaderReads = 16;
+constexpr auto kPlaybackReads = 4096;
+constexpr auto kSeekEach = 512;
+constexpr auto kCacheKeyHigh = uint64(0x5354524541424E43ULL);
+constexpr auto kEncryptionKeySize = 256;
+
+struct Access {
+	int64 offset = 0;
+	int size = 0;
+	bool headerDone = false;
+};
+
+struct Options {
+	QString trace;
+	int64 size = kDefaultSize;
+	crl::time latency = kDefaultLatency;
+	int runs = kDefaultRuns;
+	int64 limit = 0;
+	bool verbose = false;
+};
+
+struct RunResult {
+	Reader::Statistics statistics;
+	int requested = 0;
+	int accesses = 0;
+	int mismatches = 0;
+	crl::time latencyTotal = 0;
+	crl::time latencyMax = 0;
+	crl::time duration = 0;
+	bool failed = false;
+};
+
+class Integration final : public base::Integration {
+public:
+	Integration(int argc, char *argv[], bool verbose)
+	: base::Integration(argc, argv)
+	, _verbose(verbose) {
+	}
+
+	void enterFromEventLoop(FnMut<void()> &&method) override {
+		method();
+	}
+	bool logSkipDebug() override {
+		return !_verbose;
+	}
+	void logMessageDebug(const QString &message) override {
+		std::cerr << message.toStdString() << std::endl;
+	}
+	void logMessage(const QString &message) override {
+		std::cerr << message.toStdString() << std::endl;
+	}
+	void logAssertionViolation(const QString &info) override {
+		std::cerr << "Assertion Failed! " << info.toStdString() << std::endl;
+	}
+	void setCrashAnnotation(
+			const std::string &key,
+			const QString &value) override {
+	}
+
+private:
+	const bool _verbose = false;
+
+};
+
+[[nodiscard]] char ByteAt(int64 offset) {
+	return char((uint64(offset) * 2654435761ULL) >> 13);
+}
+
+[[nodiscard]] QByteArray PartBytes(int64 offset, int64 size) {
+	auto result = QByteArray(
+		int(std::min(Loader::kPartSize, size - offset)),
+		Qt::Uninitialized);
+	for (auto i = 0, count = int(result.size()); i != count; ++i) {
+		result[i] = ByteAt(offset + i);
+	}
+	return result;
+}
+
+// Sends the parts of a generated file from the main thread, after
+// a fixed delay, like a remote loader with enough bandwidth would.
+class LocalLoader final : public Loader, public base::has_weak_ptr {
+public:
+	LocalLoader(int64 size, crl::time latency)
+	: _size(size)
+	, _latency(latency) {
+	}
+
+	Storage::Cache::Key baseCacheKey() const override {
+		return { kCacheKeyHigh, uint64(_size) };
+	}
+	int64 size() const override {
+		return _size;
+	}
+
+	void load(int64 offset) override {
+		++_requested;
+		crl::on_main(this, [=] {
+			_cancelled.remove(offset);
+			base::call_delayed(_latency, this, [=] {
+				send(offset);
+			});
+		});
+	}
+	void cancel(int64 offset) override {
+		crl::on_main(this, [=] {
+			_cancelled.emplace(offset);
+		});
+	}
+	void resetPriorities() override {
+	}
+	void setPriority(int priority) override {
+	}
+	void stop() override {
+	}
+	void tryRemoveFromQueue() override {
+	}
+
+	rpl::producer<LoadedPart> parts() const override {
+		return _parts.events();
+	}
+
+	void attachDownloader(
+		not_null<Storage::StreamedFileDownloader*> downloader) override {
+	}
+	void clearAttachedDownloader() override {
+	}
+
+	[[nodiscard]] int requested() const {
+		return _requested;
+	}
+
+private:
+	void send(int64 offset) {
+		if (_cancelled.remove(offset)) {
+			return;
+		}
+		_parts.fire({ .offset = offset, .bytes = PartBytes(offset, _size) });
+	}
+
+	const int64 _size = 0;
+	const crl::time _latency = 0;
+	base::flat_set<int64> _cancelled;
+	rpl::event_stream<LoadedPart> _parts;
+	std::atomic<int> _requested = 0;
+
+};
+
+[[nodiscard]] std::vector<Access> GenerateTrace(int64 size) {
+	auto result = std::vector<Access>();
+	const auto read = [&](int64 offset) {
+		offset = std::clamp(offset, int64(0), size - kReadSize);
+		result.push_back({ .offset = offset, .size = kReadSize });
+	};
+
+	// The demuxer reads the start of the file and often its tail.
+	for (auto i = 0; i != kHeaderReads; ++i) {
+		read(i * int64(kReadSize));
+	}
+	read(size - kReadSize);
+	result.push_back({ .headerDone = true });
+
+	// A fixed seed keeps the runs comparable.
+	auto generator = std::mt19937(20240101);
+	auto seek = std::uniform_int_distribution<int64>(0, size - kReadSize);
+	auto position = int64(kHeaderReads * kReadSize);
+	for (auto i = 0; i != kPlaybackReads; ++i) {
+		if (i > 0 && !(i % kSeekEach)) {
+			position = seek(generator);
+		}
+		read(position);
+		position += kReadSize;
+	}
+	return result;
+}
+
+[[nodiscard]] std::optional<std::vector<Access>> ReadTrace(
+		const QString &path,
+		int64 size) {
+	auto file = QFile(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		return std::nullopt;
+	}
+	auto result = std::vector<Access>();
+	auto stream = QTextStream(&file);
+	while (!stream.atEnd()) {
+		const auto line = stream.readLine().trimmed();
+		const auto parts = line.split(' ', Qt::SkipEmptyParts);
+		if (parts.isEmpty() || line.startsWith('#')) {
+			continue;
+		} else if (parts[0] == u"header"_q) {
+			result.push_back({ .headerDone = true });
+		} else if (parts[0] == u"read"_q && parts.size() == 3) {
+			const auto offset = parts[1].toLongLong();
+			const auto length = parts[2].toInt();
+			if (offset < 0 || length <= 0 || offset + length > size) {
+				return std::nullopt;
+			}
+			result.push_back({ .offset = offset, .size = length });
+		} else {
+			return std::nullopt;
+		}
+	}
+	return result;
+}
+
+[[nodiscard]] RunResult Replay(
+		not_null<Reader*> reader,
+		const std::vector<Access> &trace) {
+	auto result = RunResult();
+	auto semaphore = crl::semaphore();
+	auto buffer = bytes::vector();
+	const auto started = crl::now();
+	for (const auto &access : trace) {
+		if (access.headerDone) {
+			reader->headerDone();
+			continue;
+		}
+		buffer.resize(access.size);
+		const auto accessStarted = crl::now();
+		while (true) {
+			const auto state = reader->fill(
+				access.offset,
+				bytes::make_span(buffer),
+				&semaphore);
+			if (state == Reader::FillState::Success) {
+				break;
+			} else if (state == Reader::FillState::Failed) {
+				result.failed = true;
+				return result;
+			}
+			semaphore.acquire();
+		}
+		const auto latency = crl::now() - accessStarted;
+		result.latencyTotal += latency;
+		result.latencyMax = std::max(result.latencyMax, latency);
+		++result.accesses;
+		for (auto i = 0; i != access.size; ++i) {
+			if (char(buffer[i]) != ByteAt(access.offset + i)) {
+				++result.mismatches;
+				break;
+			}
+		}
+	}
+	result.duration = crl::now() - started;
+	result.statistics = reader->statistics();
+	return result;
+}
+
+void Print(int run, const RunResult &result) {
+	const auto &stats = result.statistics;
+	const auto text = QString(
+		"Run %1: %2 accesses in %3 ms%4\n"
+		"  hit rate: %5%, fills: %6 (%7 waited for cache or loader)\n"
+		"  latency: average %8 ms, max %9 ms\n"
+		"  loaded: %10 bytes in %11 requests, requested again: %12 bytes\n"
+		"  cache slices: %13 read, %14 written, memory peak: %15 bytes"
+	).arg(run
+	).arg(result.accesses
+	).arg(result.duration
+	).arg(result.failed
+		? u", FAILED"_q
+		: result.mismatches
+		? u", %1 MISMATCHES"_q.arg(result.mismatches)
+		: QString()
+	).arg(qRound(stats.hitRate() * 100)
+	).arg(stats.fills
+	).arg(stats.fillsWaited
+	).arg(result.accesses
+		? (result.latencyTotal / double(result.accesses))
+		: 0.,
+		0,
+		'f',
+		2
+	).arg(result.latencyMax
+	).arg(stats.bytesLoaded
+	).arg(result.requested
+	).arg(stats.bytesLoadedAgain
+	).arg(stats.slicesReadFromCache
+	).arg(stats.slicesPutToCache
+	).arg(stats.memoryPeak);
+	std::cout << text.toStdString() << std::endl;
+}
+
+class Benchmark final {
+public:
+	Benchmark(Options options, std::vector<Access> trace);
+
+	void start();
+
+private:
+	void startRun();
+	void finishRun(RunResult result);
+	void finish(int code);
+
+	const Options _options;
+	const std::vector<Access> _trace;
+	const QString _path;
+	std::unique_ptr<Storage::Cache::Database> _database;
+	std::unique_ptr<Reader> _reader;
+	LocalLoader *_loader = nullptr;
+	std::thread _thread;
+	int _run = 0;
+	int _code = 0;
+
+};
+
+Benchmark::Benchmark(Options options, std::vector<Access> trace)
+: _options(std::move(options))
+, _trace(std::move(trace))
+, _path(QDir::tempPath()
+	+ u"/streaming_benchmark_%1/"_q.arg(QCoreApplication::applicationPid()))
+, _database(std::make_unique<Storage::Cache::Database>(
+	_path,
+	Storage::Cache::Database::Settings())) {
+}
+
+void Benchmark::start() {
+	auto key = bytes::vector(kEncryptionKeySize);
+	base::RandomFill(key.data(), key.size());
+	_database->open(Storage::EncryptionKey(std::move(key)), [=](
+			Storage::Cache::Error error) {
+		crl::on_main([=] {
+			if (error.type != Storage::Cache::Error::Type::None) {
+				std::cerr << "Could not open cache in: "
+					<< _path.toStdString()
+					<< std::endl;
+				finish(1);
+			} else {
+				startRun();
+			}
+		});
+	});
+}
+
+void Benchmark::startRun() {
+	auto loader = std::make_unique<LocalLoader>(
+		_options.size,
+		_options.latency);
+	_loader = loader.get();
+	_reader = std::make_unique<Reader>(std::move(loader), _database.get());
+	_reader->startStreaming();
+
+	const auto reader = _reader.get();
+	_thread = std::thread([=] {
+		auto result = Replay(reader, _trace);
+		crl::on_main([=, result = std::move(result)]() mutable {
+			finishRun(std::move(result));
+		});
+	});
+}
+
+void Benchmark::finishRun(RunResult result) {
+	_thread.join();
+	result.requested = _loader->requested();
+	_reader->stopStreaming();
+
+	// Writes the slices still in memory to the cache for the next run.
+	_reader = nullptr;
+	_loader = nullptr;
+
+	Print(++_run, result);
+	if (result.failed || result.mismatches) {
+		finish(1);
+	} else if (_run < _options.runs) {
+		startRun();
+	} else {
+		finish(0);
+	}
+}
+
+void Benchmark::finish(int code) {
+	_code = code;
+	_database->close([=] {
+		crl::on_main([=] {
+			_database = nullptr;
+			QDir(_path).removeRecursively();
+			QCoreApplication::exit(_code);
+		});
+	});
+}
+
+[[nodiscard]] std::optional<Options> ParseOptions(const QStringList &list) {
+	auto result = Options();
+	for (auto i = 1; i < list.size(); ++i) {
+		const auto &name = list[i];
+		const auto value = (i + 1 < list.size()) ? list[i + 1] : QString();
+		if (name == u"--verbose"_q) {
+			result.verbose = true;
+			continue;
+		} else if (value.isEmpty()) {
+			return std::nullopt;
+		} else if (name == u"--trace"_q) {
+			result.trace = value;
+		} else if (name == u"--size"_q) {
+			result.size = value.toLongLong() * 1024 * 1024;
+		} else if (name == u"--latency"_q) {
+			result.latency = value.toLongLong();
+		} else if (name == u"--runs"_q) {
+			result.runs = value.toInt();
+		} else if (name == u"--limit"_q) {
+			result.limit = value.toLongLong() * 1024 * 1024;
+		} else {
+			return std::nullopt;
+		}
+		++i;
+	}
+	if (result.size <= kReadSize
+		|| result.size > std::numeric_limits<uint32>::max()
+		|| result.latency < 0
+		|| result.runs <= 0
+		|| result.limit < 0) {
+		return std::nullopt;
+	}
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	auto application = QCoreApplication(argc, argv);
+	const auto options = ParseOptions(QCoreApplication::arguments());
+	if (!options) {
+		std::cerr << "Usage: StreamingBenchmark [--trace <file>] "
+			"[--size <megabytes>] [--latency <ms>] [--runs <count>] "
+			"[--limit <megabytes>] [--verbose]"
+			<< std::endl;
+		return 1;
+	}
+	auto trace = options->trace.isEmpty()
+		? std::make_optional(GenerateTrace(options->size))
+		: ReadTrace(options->trace, options->size);
+	if (!trace) {
+		std::cerr << "Bad trace: " << options->trace.toStdString() << std::endl;
+		return 1;
+	}
+
+	auto integration = Integration(argc, argv, options->verbose);
+	base::Integration::Set(&integration);
+	Ui::MainQueueProcessor processor;
+	base::ConcurrentTimerEnvironment environment;
+
+	if (options->limit > 0) {
+		SlicesMemory::SetLimit(options->limit);
+	}
+	auto benchmark = Benchmark(*options, std::move(*trace));
+	benchmark.start();
+	return application.exec();
+}
@@ -0,0 +1,295 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "calls/group/calls_group_viewport_frame.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QStringList>
+
+#include <iostream>
+
+// Headless benchmark of the software group call video tiles.
+//
+// Paints a 3x3 grid of tiles showing the same video frame, for every
+// frame rotation, in three ways:
+// - painter: the previous path, a smoothing QPainter scales (and for
+//   90 / 270 degrees first rotates) the full frame on each paint;
+// - prepare: Calls::Group::PrepareTileFrame() on each paint, like when
+//   every paint shows a new video frame, and an unscaled blit;
+// - blit: only the unscaled blit of already prepared frames, like when
+//   the tiles are repainted without a new video frame.
+//
+// Usage: TileBenchmark [--iterations <count>] [--frame <width>x<height>]
+//   [--canvas <width>x<height>]
+
+namespace {
+
+constexpr auto kDefaultIterations = 50;
+constexpr auto kDefaultFrame = QSize(1280, 720);
+constexpr auto kDefaultCanvas = QSize(1920, 1080);
+constexpr auto kGrid = 3;
+constexpr auto kTileSkip = 4;
+
+struct Options {
+	int iterations = kDefaultIterations;
+	QSize frame = kDefaultFrame;
+	QSize canvas = kDefaultCanvas;
+};
+
+struct Timing {
+	double painter = 0.;
+	double prepare = 0.;
+	double blit = 0.;
+	double difference = 0.;
+};
+
+// Copies of the helpers from media/view/media_view_pip.cpp,
+// the previous path used them directly.
+[[nodiscard]] QRect RotatedRect(QRect rect, int rotation) {
+	switch (rotation) {
+	case 0: return rect;
+	case 90: return QRect(
+		rect.y(),
+		-rect.x() - rect.width(),
+		rect.height(),
+		rect.width());
+	case 180: return QRect(
+		-rect.x() - rect.width(),
+		-rect.y() - rect.height(),
+		rect.width(),
+		rect.height());
+	case 270: return QRect(
+		-rect.y() - rect.height(),
+		rect.x(),
+		rect.height(),
+		rect.width());
+	}
+	Unexpected("Rotation in RotatedRect.");
+}
+
+[[nodiscard]] QSize FlipSizeByRotation(QSize size, int rotation) {
+	return (((rotation / 90) % 2) == 1)
+		? QSize(size.height(), size.width())
+		: size;
+}
+
+[[nodiscard]] QImage GenerateFrame(QSize size) {
+	auto result = QImage(size, QImage::Format_ARGB32_Premultiplied);
+	for (auto y = 0; y != size.height(); ++y) {
+		const auto line = reinterpret_cast<uint32*>(result.scanLine(y));
+		for (auto x = 0; x != size.width(); ++x) {
+			// A gradient with some detail, so that smoothing has work.
+			const auto noise = ((x * 7 + y * 13) ^ (x * y)) & 0x1F;
+			line[x] = qRgb(
+				(x * 255 / size.width()) ^ noise,
+				(y * 255 / size.height()) ^ noise,
+				((x + y) * 255 / (size.width() + size.height())));
+		}
+	}
+	return result;
+}
+
+[[nodiscard]] std::vector<QRect> GenerateTiles(QSize canvas) {
+	auto result = std::vector<QRect>();
+	const auto width = (canvas.width() - (kGrid + 1) * kTileSkip) / kGrid;
+	const auto height = (canvas.height() - (kGrid + 1) * kTileSkip) / kGrid;
+	for (auto row = 0; row != kGrid; ++row) {
+		for (auto column = 0; column != kGrid; ++column) {
+			result.emplace_back(
+				kTileSkip + column * (width + kTileSkip),
+				kTileSkip + row * (height + kTileSkip),
+				width,
+				height);
+		}
+	}
+	return result;
+}
+
+[[nodiscard]] QRect TileTarget(QRect tile, QSize frame, int rotation) {
+	const auto scaled = FlipSizeByRotation(
+		frame,
+		rotation
+	).scaled(tile.size(), Qt::KeepAspectRatio);
+	const auto left = (tile.width() - scaled.width()) / 2;
+	const auto top = (tile.height() - scaled.height()) / 2;
+	return QRect(tile.topLeft() + QPoint(left, top), scaled);
+}
+
+void PaintWithPainter(
+		QPainter &p,
+		const QImage &frame,
+		QRect target,
+		int rotation) {
+	if (!(rotation % 180)) {
+		if (rotation) {
+			p.save();
+			p.rotate(rotation);
+		}
+		p.drawImage(RotatedRect(target, rotation), frame);
+		if (rotation) {
+			p.restore();
+		}
+	} else {
+		p.drawImage(
+			target,
+			frame.transformed(QTransform().rotate(rotation)));
+	}
+}
+
+// Average absolute channel difference, to make sure that
+// both paths paint the same picture.
+[[nodiscard]] double Difference(const QImage &a, const QImage &b) {
+	auto total = 0.;
+	for (auto y = 0; y != a.height(); ++y) {
+		const auto first = reinterpret_cast<const uint32*>(a.scanLine(y));
+		const auto second = reinterpret_cast<const uint32*>(b.scanLine(y));
+		for (auto x = 0; x != a.width(); ++x) {
+			total += std::abs(qRed(first[x]) - qRed(second[x]))
+				+ std::abs(qGreen(first[x]) - qGreen(second[x]))
+				+ std::abs(qBlue(first[x]) - qBlue(second[x]));
+		}
+	}
+	return total / (3. * a.width() * a.height());
+}
+
+[[nodiscard]] double Measure(int iterations, Fn<void()> paint) {
+	paint();
+	auto timer = QElapsedTimer();
+	timer.start();
+	for (auto i = 0; i != iterations; ++i) {
+		paint();
+	}
+	return timer.nsecsElapsed() / (1000000. * iterations);
+}
+
+[[nodiscard]] Timing Run(
+		const Options &options,
+		const QImage &frame,
+		const std::vector<QRect> &tiles,
+		int rotation) {
+	auto result = Timing();
+	auto canvas = QImage(
+		options.canvas,
+		QImage::Format_ARGB32_Premultiplied);
+	const auto clear = [&](QPainter &p) {
+		p.fillRect(QRect(QPoint(), options.canvas), Qt::black);
+	};
+
+	result.painter = Measure(options.iterations, [&] {
+		auto p = QPainter(&canvas);
+		p.setRenderHint(QPainter::Antialiasing);
+		p.setRenderHint(QPainter::SmoothPixmapTransform);
+		clear(p);
+		for (const auto &tile : tiles) {
+			const auto target = TileTarget(tile, frame.size(), rotation);
+			PaintWithPainter(p, frame, target, rotation);
+		}
+	});
+	const auto painted = canvas;
+
+	auto prepared = std::vector<QImage>(tiles.size());
+	result.prepare = Measure(options.iterations, [&] {
+		auto p = QPainter(&canvas);
+		clear(p);
+		for (auto i = 0; i != int(tiles.size()); ++i) {
+			const auto target = TileTarget(tiles[i], frame.size(), rotation);
+			prepared[i] = Calls::Group::PrepareTileFrame(
+				frame,
+				rotation,
+				target.size());
+			p.drawImage(target.topLeft(), prepared[i]);
+		}
+	});
+	result.difference = Difference(painted, canvas);
+
+	result.blit = Measure(options.iterations, [&] {
+		auto p = QPainter(&canvas);
+		clear(p);
+		for (auto i = 0; i != int(tiles.size()); ++i) {
+			const auto target = TileTarget(tiles[i], frame.size(), rotation);
+			p.drawImage(target.topLeft(), prepared[i]);
+		}
+	});
+	return result;
+}
+
+[[nodiscard]] std::optional<QSize> ParseSize(const QString &value) {
+	const auto parts = value.split('x');
+	if (parts.size() != 2) {
+		return std::nullopt;
+	}
+	const auto result = QSize(parts[0].toInt(), parts[1].toInt());
+	return (result.width() > 0 && result.height() > 0)
+		? std::make_optional(result)
+		: std::nullopt;
+}
+
+[[nodiscard]] std::optional<Options> ParseOptions(const QStringList &list) {
+	auto result = Options();
+	for (auto i = 1; i + 1 < list.size(); i += 2) {
+		const auto &name = list[i];
+		const auto &value = list[i + 1];
+		if (name == u"--iterations"_q) {
+			result.iterations = value.toInt();
+		} else if (name == u"--frame"_q || name == u"--canvas"_q) {
+			const auto size = ParseSize(value);
+			if (!size) {
+				return std::nullopt;
+			}
+			((name == u"--frame"_q) ? result.frame : result.canvas) = *size;
+		} else {
+			return std::nullopt;
+		}
+	}
+	if (!(list.size() % 2)
+		|| result.iterations <= 0
+		|| result.canvas.width() < kGrid * (kTileSkip + 1)
+		|| result.canvas.height() < kGrid * (kTileSkip + 1)) {
+		return std::nullopt;
+	}
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	auto application = QCoreApplication(argc, argv);
+	const auto options = ParseOptions(QCoreApplication::arguments());
+	if (!options) {
+		std::cerr << "Usage: TileBenchmark [--iterations <count>] "
+			"[--frame <width>x<height>] [--canvas <width>x<height>]"
+			<< std::endl;
+		return 1;
+	}
+	const auto frame = GenerateFrame(options->frame);
+	const auto tiles = GenerateTiles(options->canvas);
+
+	std::cout << QString(
+		"%1 tiles of a %2x%3 frame on a %4x%5 canvas, %6 iterations."
+	).arg(int(tiles.size())
+	).arg(options->frame.width()
+	).arg(options->frame.height()
+	).arg(options->canvas.width()
+	).arg(options->canvas.height()
+	).arg(options->iterations).toStdString() << std::endl;
+
+	for (const auto rotation : { 0, 90, 180, 270 }) {
+		const auto timing = Run(*options, frame, tiles, rotation);
+		std::cout << QString(
+			"Rotation %1: painter %2 ms, prepare %3 ms (x%4), "
+			"blit %5 ms (x%6), difference %7"
+		).arg(rotation, 3
+		).arg(timing.painter, 0, 'f', 2
+		).arg(timing.prepare, 0, 'f', 2
+		).arg(timing.painter / timing.prepare, 0, 'f', 1
+		).arg(timing.blit, 0, 'f', 2
+		).arg(timing.painter / timing.blit, 0, 'f', 1
+		).arg(timing.difference, 0, 'f', 2).toStdString() << std::endl;
+	}
+	return 0;
+}
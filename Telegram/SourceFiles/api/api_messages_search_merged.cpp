@@ -7,9 +7,17 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 */
 #include "api/api_messages_search_merged.h"
 
+#include "data/data_messages_text_index.h"
+#include "data/data_session.h"
 #include "history/history.h"
+#include "history/history_item.h"
 
 namespace Api {
+namespace {
+
+constexpr auto kLocalSearchLimit = 50;
+
+} // namespace
 
 bool MessagesSearchMerged::RequestCompare::operator()(
 		const Request &a,
@@ -18,7 +26,8 @@ bool MessagesSearchMerged::RequestCompare::operator()(
 }
 
 MessagesSearchMerged::MessagesSearchMerged(not_null<History*> history)
-: _apiSearch(history) {
+: _history(history)
+, _apiSearch(history) {
 	if (const auto migrated = history->migrateFrom()) {
 		_migratedSearch.emplace(migrated);
 	}
@@ -86,6 +95,7 @@ void MessagesSearchMerged::clear() {
 }
 
 void MessagesSearchMerged::search(const Request &search) {
+	searchLocal(search);
 	if (_migratedSearch) {
 		_waitingForTotal = true;
 		_migratedSearch->searchMessages(search.query, search.from);
@@ -93,6 +103,34 @@ void MessagesSearchMerged::search(const Request &search) {
 	_apiSearch.searchMessages(search.query, search.from);
 }
 
+void MessagesSearchMerged::searchLocal(const Request &search) {
+	// Already loaded messages are shown until the server results arrive.
+	// Those have a non-empty nextToken, so they replace the local ones.
+	auto &index = _history->owner().messagesTextIndex();
+	auto found = FoundMessages();
+	const auto append = [&](not_null<History*> history) {
+		const auto items = index.search({
+			.query = search.query,
+			.history = history,
+			.from = search.from,
+			.limit = kLocalSearchLimit,
+		});
+		for (const auto &item : items) {
+			found.messages.push_back(item->fullId());
+		}
+	};
+	append(_history);
+	if (const auto migrated = _history->migrateFrom()) {
+		append(migrated);
+	}
+	if (found.messages.empty()) {
+		return;
+	}
+	found.total = int(found.messages.size());
+	_concatedFound = std::move(found);
+	_newFounds.fire({});
+}
+
 void MessagesSearchMerged::searchMore() {
 	if (_migratedSearch && _isFull) {
 		_migratedSearch->searchMore();
@@ -39,7 +39,9 @@ public:
 
 private:
 	void addFound(const FoundMessages &data);
+	void searchLocal(const Request &search);
 
+	const not_null<History*> _history;
 	MessagesSearch _apiSearch;
 
 	std::optional<MessagesSearch> _migratedSearch;
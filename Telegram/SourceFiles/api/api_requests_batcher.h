@@ -0,0 +1,149 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#pragma once
+
+#include "base/flat_map.h"
+#include "base/timer.h"
+#include "base/weak_ptr.h"
+
+namespace Api {
+
+// Collects the keys requested during a short time window and sends one
+// request for all the keys of the same group, like all the message ids
+// of one channel. A key that is already being requested is not sent again.
+// Everyone who asked for a key is called back when its request finishes.
+template <typename Group, typename Key>
+class RequestsBatcher final : public base::has_weak_ptr {
+public:
+	using Keys = std::vector<Key>;
+
+	// The finish callback must be called both on success and on failure.
+	using Send = Fn<void(Group group, Keys keys, Fn<void()> finish)>;
+
+	RequestsBatcher(Send send, crl::time delay, int limit);
+
+	void request(Group group, Key key, Fn<void()> done = nullptr);
+	[[nodiscard]] bool requesting(const Group &group, const Key &key) const;
+
+private:
+	struct Entry {
+		std::vector<Fn<void()>> callbacks;
+		int batchId = 0;
+	};
+	using Entries = base::flat_map<Key, Entry>;
+
+	void sendPending();
+	void finish(const Group &group, int batchId);
+
+	const Send _send;
+	const crl::time _delay = 0;
+	const int _limit = 0;
+
+	base::flat_map<Group, Entries> _groups;
+	int _lastBatchId = 0;
+	base::Timer _timer;
+
+};
+
+template <typename Group, typename Key>
+RequestsBatcher<Group, Key>::RequestsBatcher(
+	Send send,
+	crl::time delay,
+	int limit)
+: _send(std::move(send))
+, _delay(delay)
+, _limit(limit)
+, _timer([=] { sendPending(); }) {
+	Expects(_send != nullptr);
+	Expects(_limit > 0);
+}
+
+template <typename Group, typename Key>
+void RequestsBatcher<Group, Key>::request(
+		Group group,
+		Key key,
+		Fn<void()> done) {
+	const auto [i, added] = _groups[group].try_emplace(key);
+	if (done) {
+		i->second.callbacks.push_back(std::move(done));
+	}
+	if (added && !_timer.isActive()) {
+		_timer.callOnce(_delay);
+	}
+}
+
+template <typename Group, typename Key>
+bool RequestsBatcher<Group, Key>::requesting(
+		const Group &group,
+		const Key &key) const {
+	const auto i = _groups.find(group);
+	return (i != end(_groups)) && i->second.contains(key);
+}
+
+template <typename Group, typename Key>
+void RequestsBatcher<Group, Key>::sendPending() {
+	struct Batch {
+		Group group;
+		int id = 0;
+		Keys keys;
+	};
+	auto batches = std::vector<Batch>();
+	for (auto &[group, entries] : _groups) {
+		for (auto &[key, entry] : entries) {
+			if (entry.batchId) {
+				continue;
+			} else if (batches.empty()
+				|| batches.back().group != group
+				|| int(batches.back().keys.size()) == _limit) {
+				batches.push_back({ .group = group, .id = ++_lastBatchId });
+			}
+			entry.batchId = batches.back().id;
+			batches.back().keys.push_back(key);
+		}
+	}
+
+	// Send after the loop, because finish() may be called synchronously.
+	for (auto &batch : batches) {
+		_send(
+			batch.group,
+			std::move(batch.keys),
+			crl::guard(this, [=, group = batch.group, id = batch.id] {
+				finish(group, id);
+			}));
+	}
+}
+
+template <typename Group, typename Key>
+void RequestsBatcher<Group, Key>::finish(const Group &group, int batchId) {
+	const auto i = _groups.find(group);
+	if (i == end(_groups)) {
+		return;
+	}
+	auto callbacks = std::vector<Fn<void()>>();
+	auto &entries = i->second;
+	for (auto j = begin(entries); j != end(entries);) {
+		if (j->second.batchId == batchId) {
+			auto &list = j->second.callbacks;
+			callbacks.insert(
+				end(callbacks),
+				std::make_move_iterator(begin(list)),
+				std::make_move_iterator(end(list)));
+			j = entries.erase(j);
+		} else {
+			++j;
+		}
+	}
+	if (entries.empty()) {
+		_groups.erase(i);
+	}
+	for (const auto &callback : callbacks) {
+		callback();
+	}
+}
+
+} // namespace Api
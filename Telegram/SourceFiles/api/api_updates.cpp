@@ -45,6 +45,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "history/history_item.h"
 #include "history/history_unread_things.h"
 #include "core/application.h"
+#include "core/core_tracing.h"
 #include "storage/storage_account.h"
 #include "storage/storage_facade.h"
 #include "storage/storage_user_photos.h"
@@ -293,6 +294,8 @@ void Updates::checkLastUpdate(bool afterSleep) {
 void Updates::feedUpdateVector(
 		const MTPVector<MTPUpdate> &updates,
 		SkipUpdatePolicy policy) {
+	TRACE_SCOPE("Api::Updates::feedUpdateVector");
+
 	auto list = updates.v;
 	const auto hasGroupCallParticipantUpdates = ranges::contains(
 		list,
@@ -1095,6 +1098,8 @@ void Updates::handleEmojiInteraction(
 }
 
 void Updates::applyUpdatesNoPtsCheck(const MTPUpdates &updates) {
+	TRACE_SCOPE("Api::Updates::applyUpdatesNoPtsCheck");
+
 	switch (updates.type()) {
 	case mtpc_updateShortMessage: {
 		const auto &d = updates.c_updateShortMessage();
@@ -1336,6 +1341,8 @@ void Updates::applyUpdateNoPtsCheck(const MTPUpdate &update) {
 void Updates::applyUpdates(
 		const MTPUpdates &updates,
 		uint64 sentMessageRandomId) {
+	TRACE_SCOPE("Api::Updates::applyUpdates");
+
 	const auto randomId = sentMessageRandomId;
 
 	switch (updates.type()) {
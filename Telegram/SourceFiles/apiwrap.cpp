@@ -106,8 +106,10 @@ constexpr auto kSaveCloudDraftTimeout = 1000;
 constexpr auto kTopPromotionInterval = TimeId(60 * 60);
 constexpr auto kTopPromotionMinDelay = TimeId(10);
 constexpr auto kSmallDelayMs = 5;
+constexpr auto kMessageDataRequestLimit = 100;
 constexpr auto kReadFeaturedSetsTimeout = crl::time(1000);
 constexpr auto kFileLoaderQueueStopTimeout = crl::time(5000);
+constexpr auto kFileLoaderMaxThreads = 4;
 constexpr auto kStickersByEmojiInvalidateTimeout = crl::time(6 * 1000);
 constexpr auto kNotifySettingSaveTimeout = crl::time(1000);
 constexpr auto kDialogsFirstLoad = 20;
@@ -149,12 +151,19 @@ void ShowChannelsLimitBox(not_null<PeerData*> peer) {
 ApiWrap::ApiWrap(not_null<Main::Session*> session)
 : MTP::Sender(&session->account().mtp())
 , _session(session)
-, _messageDataResolveDelayed([=] { resolveMessageDatas(); })
+, _messageDataRequests(
+	[=](ChannelData *channel, std::vector<MsgId> ids, Fn<void()> finish) {
+		resolveMessageDatas(channel, std::move(ids), std::move(finish));
+	},
+	0,
+	kMessageDataRequestLimit)
 , _webPagesTimer([=] { resolveWebPages(); })
 , _draftsSaveTimer([=] { saveDraftsToCloud(); })
 , _featuredSetsReadTimer([=] { readFeaturedSets(); })
 , _dialogsLoadState(std::make_unique<DialogsLoadState>())
-, _fileLoader(std::make_unique<TaskQueue>(kFileLoaderQueueStopTimeout))
+, _fileLoader(std::make_unique<TaskQueue>(
+	kFileLoaderQueueStopTimeout,
+	std::clamp(QThread::idealThreadCount() / 2, 1, kFileLoaderMaxThreads)))
 , _topPromotionTimer([=] { refreshTopPromotion(); })
 , _updateNotifyTimer([=] { sendNotifySettingsUpdates(); })
 , _authorizations(std::make_unique<Api::Authorizations>(this))
@@ -555,132 +564,36 @@ void ApiWrap::requestMessageData(
 		PeerData *peer,
 		MsgId msgId,
 		Fn<void()> done) {
-	auto &requests = (peer && peer->isChannel())
-		? _channelMessageDataRequests[peer->asChannel()][msgId]
-		: _messageDataRequests[msgId];
-	if (done) {
-		requests.callbacks.push_back(std::move(done));
-	}
-	if (!requests.requestId) {
-		_messageDataResolveDelayed.call();
-	}
-}
-
-QVector<MTPInputMessage> ApiWrap::collectMessageIds(
-		const MessageDataRequests &requests) {
-	auto result = QVector<MTPInputMessage>();
-	result.reserve(requests.size());
-	for (const auto &[msgId, request] : requests) {
-		if (request.requestId > 0) {
-			continue;
-		}
-		result.push_back(MTP_inputMessageID(MTP_int(msgId)));
-	}
-	return result;
+	_messageDataRequests.request(
+		peer ? peer->asChannel() : nullptr,
+		msgId,
+		std::move(done));
 }
 
-auto ApiWrap::messageDataRequests(ChannelData *channel, bool onlyExisting)
--> MessageDataRequests* {
-	if (!channel) {
-		return &_messageDataRequests;
-	}
-	const auto i = _channelMessageDataRequests.find(channel);
-	if (i != end(_channelMessageDataRequests)) {
-		return &i->second;
-	} else if (onlyExisting) {
-		return nullptr;
-	}
-	return &_channelMessageDataRequests.emplace(
-		channel,
-		MessageDataRequests()
-	).first->second;
-}
-
-void ApiWrap::resolveMessageDatas() {
-	if (_messageDataRequests.empty() && _channelMessageDataRequests.empty()) {
-		return;
-	}
-
-	const auto ids = collectMessageIds(_messageDataRequests);
-	if (!ids.isEmpty()) {
-		const auto requestId = request(MTPmessages_GetMessages(
-			MTP_vector<MTPInputMessage>(ids)
-		)).done([=](
-				const MTPmessages_Messages &result,
-				mtpRequestId requestId) {
-			_session->data().processExistingMessages(nullptr, result);
-			finalizeMessageDataRequest(nullptr, requestId);
-		}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-			finalizeMessageDataRequest(nullptr, requestId);
-		}).afterDelay(kSmallDelayMs).send();
-
-		for (auto &[msgId, request] : _messageDataRequests) {
-			if (request.requestId > 0) {
-				continue;
-			}
-			request.requestId = requestId;
-		}
-	}
-	for (auto j = _channelMessageDataRequests.begin(); j != _channelMessageDataRequests.cend();) {
-		if (j->second.empty()) {
-			j = _channelMessageDataRequests.erase(j);
-			continue;
-		}
-		const auto ids = collectMessageIds(j->second);
-		if (!ids.isEmpty()) {
-			const auto channel = j->first;
-			const auto requestId = request(MTPchannels_GetMessages(
-				channel->inputChannel,
-				MTP_vector<MTPInputMessage>(ids)
-			)).done([=](
-					const MTPmessages_Messages &result,
-					mtpRequestId requestId) {
-				_session->data().processExistingMessages(channel, result);
-				finalizeMessageDataRequest(channel, requestId);
-			}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-				finalizeMessageDataRequest(channel, requestId);
-			}).afterDelay(kSmallDelayMs).send();
-
-			for (auto &[msgId, request] : j->second) {
-				if (request.requestId > 0) {
-					continue;
-				}
-				request.requestId = requestId;
-			}
-		}
-		++j;
-	}
-}
-
-void ApiWrap::finalizeMessageDataRequest(
+void ApiWrap::resolveMessageDatas(
 		ChannelData *channel,
-		mtpRequestId requestId) {
-	auto requests = messageDataRequests(channel, true);
-	if (!requests) {
-		return;
-	}
-	auto callbacks = std::vector<Fn<void()>>();
-	for (auto i = requests->begin(); i != requests->cend();) {
-		if (i->second.requestId == requestId) {
-			auto &list = i->second.callbacks;
-			if (callbacks.empty()) {
-				callbacks = std::move(list);
-			} else {
-				callbacks.insert(
-					end(callbacks),
-					std::make_move_iterator(begin(list)),
-					std::make_move_iterator(end(list)));
-			}
-			i = requests->erase(i);
-		} else {
-			++i;
-		}
-	}
-	if (channel && requests->empty()) {
-		_channelMessageDataRequests.remove(channel);
+		std::vector<MsgId> ids,
+		Fn<void()> finish) {
+	auto list = QVector<MTPInputMessage>();
+	list.reserve(ids.size());
+	for (const auto &msgId : ids) {
+		list.push_back(MTP_inputMessageID(MTP_int(msgId)));
 	}
-	for (const auto &callback : callbacks) {
-		callback();
+	if (channel) {
+		request(MTPchannels_GetMessages(
+			channel->inputChannel,
+			MTP_vector<MTPInputMessage>(std::move(list))
+		)).done([=](const MTPmessages_Messages &result) {
+			_session->data().processExistingMessages(channel, result);
+			finish();
+		}).fail(finish).afterDelay(kSmallDelayMs).send();
+	} else {
+		request(MTPmessages_GetMessages(
+			MTP_vector<MTPInputMessage>(std::move(list))
+		)).done([=](const MTPmessages_Messages &result) {
+			_session->data().processExistingMessages(nullptr, result);
+			finish();
+		}).fail(finish).afterDelay(kSmallDelayMs).send();
 	}
 }
 
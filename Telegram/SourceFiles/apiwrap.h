@@ -8,6 +8,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #pragma once
 
 #include "api/api_common.h"
+#include "api/api_requests_batcher.h"
 #include "base/timer.h"
 #include "base/flat_map.h"
 #include "base/flat_set.h"
@@ -387,13 +388,6 @@ public:
 	static constexpr auto kJoinErrorDuration = 5 * crl::time(1000);
 
 private:
-	struct MessageDataRequest {
-		using Callbacks = std::vector<Fn<void()>>;
-
-		mtpRequestId requestId = 0;
-		Callbacks callbacks;
-	};
-	using MessageDataRequests = base::flat_map<MsgId, MessageDataRequest>;
 	using SharedMediaType = Storage::SharedMediaType;
 
 	struct StickersByEmoji {
@@ -427,16 +421,10 @@ private:
 
 	void saveDraftsToCloud();
 
-	void resolveMessageDatas();
-	void finalizeMessageDataRequest(
+	void resolveMessageDatas(
 		ChannelData *channel,
-		mtpRequestId requestId);
-
-	[[nodiscard]] QVector<MTPInputMessage> collectMessageIds(
-		const MessageDataRequests &requests);
-	[[nodiscard]] MessageDataRequests *messageDataRequests(
-		ChannelData *channel,
-		bool onlyExisting = false);
+		std::vector<MsgId> ids,
+		Fn<void()> finish);
 
 	void gotChatFull(
 		not_null<PeerData*> peer,
@@ -540,11 +528,7 @@ private:
 
 	base::flat_map<QString, int> _modifyRequests;
 
-	MessageDataRequests _messageDataRequests;
-	base::flat_map<
-		not_null<ChannelData*>,
-		MessageDataRequests> _channelMessageDataRequests;
-	SingleQueuedInvokation _messageDataResolveDelayed;
+	Api::RequestsBatcher<ChannelData*, MsgId> _messageDataRequests;
 
 	using PeerRequests = base::flat_map<PeerData*, mtpRequestId>;
 	PeerRequests _fullPeerRequests;
@@ -0,0 +1,32 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "calls/group/calls_group_viewport_frame.h"
+
+#include <QtGui/QTransform>
+
+namespace Calls::Group {
+
+QImage PrepareTileFrame(const QImage &image, int rotation, QSize size) {
+	// Scale before rotating, so that the rotation touches fewer pixels.
+	const auto unrotated = (((rotation / 90) % 2) == 1)
+		? size.transposed()
+		: size;
+	auto result = (image.size() == unrotated)
+		? image
+		: image.scaled(
+			unrotated,
+			Qt::IgnoreAspectRatio,
+			Qt::SmoothTransformation);
+	if (rotation) {
+		result = result.transformed(QTransform().rotate(rotation));
+	}
+	return std::move(result).convertToFormat(
+		QImage::Format_ARGB32_Premultiplied);
+}
+
+} // namespace Calls::Group
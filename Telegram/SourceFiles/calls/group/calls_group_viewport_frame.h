@@ -0,0 +1,19 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#pragma once
+
+namespace Calls::Group {
+
+// Scales and rotates a video frame to the exact tile size in pixels,
+// in the premultiplied format that is painted without conversion.
+[[nodiscard]] QImage PrepareTileFrame(
+	const QImage &image,
+	int rotation,
+	QSize size);
+
+} // namespace Calls::Group
@@ -8,6 +8,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "calls/group/calls_group_viewport_raster.h"
 
 #include "calls/group/calls_group_common.h"
+#include "calls/group/calls_group_viewport_frame.h"
 #include "calls/group/calls_group_viewport_tile.h"
 #include "calls/group/calls_group_members_row.h"
 #include "data/data_peer.h"
@@ -24,6 +25,11 @@ namespace {
 
 constexpr auto kBlurRadius = 15;
 
+// Tiles showing less than a quarter of the source pixels are refreshed
+// at most at ~15 fps, they are too small for the difference to be seen.
+constexpr auto kSmallTileRatio = 4;
+constexpr auto kSmallTileFrameDelay = crl::time(66);
+
 } // namespace
 
 Viewport::RendererSW::RendererSW(not_null<Viewport*> owner)
@@ -33,7 +39,8 @@ Viewport::RendererSW::RendererSW(not_null<Viewport*> owner)
 	(st::groupCallVideoTile.pinPadding.top()
 		+ st::groupCallVideoTile.pin.icon.height()
 		+ st::groupCallVideoTile.pinPadding.bottom()) / 2,
-	st::radialBg) {
+	st::radialBg)
+, _throttledTilesTimer([=] { updateThrottledTiles(); }) {
 }
 
 void Viewport::RendererSW::paintFallback(
@@ -84,6 +91,66 @@ void Viewport::RendererSW::validateUserpicFrame(
 		kBlurRadius);
 }
 
+void Viewport::RendererSW::validatePreparedFrame(
+		not_null<VideoTile*> tile,
+		TileData &data,
+		const QImage &image,
+		int index,
+		int rotation,
+		QSize size) {
+	const auto factor = style::DevicePixelRatio();
+	const auto pixels = size * factor;
+
+	// Userpic and paused frames are tracked by the image itself,
+	// live video frames by their index in the track.
+	const auto key = (index < 0) ? image.cacheKey() : qint64();
+	const auto changed = data.prepared.isNull()
+		|| (data.prepared.size() != pixels)
+		|| (data.preparedRotation != rotation)
+		|| (data.preparedKey != key);
+	if (!changed && data.preparedIndex == index) {
+		return;
+	}
+	const auto now = crl::now();
+	const auto small = (int64(pixels.width()) * pixels.height()
+		* kSmallTileRatio <= int64(image.width()) * image.height());
+	if (!changed && small && now - data.preparedAt < kSmallTileFrameDelay) {
+		// The skipped frame may be the last one for a long time,
+		// like in a static screencast, so show it a bit later.
+		updateThrottledTile(tile, data.preparedAt + kSmallTileFrameDelay);
+		return;
+	}
+	data.prepared = PrepareTileFrame(image, rotation, pixels);
+	data.prepared.setDevicePixelRatio(factor);
+	data.preparedKey = key;
+	data.preparedIndex = index;
+	data.preparedRotation = rotation;
+	data.preparedAt = now;
+}
+
+void Viewport::RendererSW::updateThrottledTile(
+		not_null<VideoTile*> tile,
+		crl::time when) {
+	_throttledTiles.emplace(tile);
+	const auto delay = std::max(when - crl::now(), crl::time(1));
+	if (!_throttledTilesTimer.isActive()
+		|| _throttledTilesTimer.remainingTime() > delay) {
+		_throttledTilesTimer.callOnce(delay);
+	}
+}
+
+void Viewport::RendererSW::updateThrottledTiles() {
+	for (const auto &tile : base::take(_throttledTiles)) {
+		const auto i = ranges::find(
+			_owner->_tiles,
+			tile.get(),
+			&std::unique_ptr<VideoTile>::get);
+		if (i != end(_owner->_tiles)) {
+			_owner->widget()->update(tile->geometry());
+		}
+	}
+}
+
 void Viewport::RendererSW::paintTile(
 		Painter &p,
 		not_null<VideoTile*> tile,
@@ -140,19 +207,15 @@ void Viewport::RendererSW::paintTile(
 	const auto left = (width - scaled.width()) / 2;
 	const auto top = (height - scaled.height()) / 2;
 	const auto target = QRect(QPoint(x + left, y + top), scaled);
-	if (UsePainterRotation(frameRotation)) {
-		if (frameRotation) {
-			p.save();
-			p.rotate(frameRotation);
-		}
-		p.drawImage(RotatedRect(target, frameRotation), image);
-		if (frameRotation) {
-			p.restore();
-		}
-	} else if (frameRotation) {
-		p.drawImage(target, RotateFrameImage(image, frameRotation));
-	} else {
-		p.drawImage(target, image);
+	if (!target.isEmpty()) {
+		validatePreparedFrame(
+			tile,
+			tileData,
+			image,
+			(_userpicFrame || _pausedFrame) ? -1 : data.index,
+			frameRotation,
+			target.size());
+		p.drawImage(target.topLeft(), tileData.prepared);
 	}
 	bg -= target;
 
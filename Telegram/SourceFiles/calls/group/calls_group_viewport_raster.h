@@ -8,6 +8,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #pragma once
 
 #include "calls/group/calls_group_viewport.h"
+#include "base/timer.h"
 #include "ui/round_rect.h"
 #include "ui/effects/cross_line.h"
 #include "ui/gl/gl_surface.h"
@@ -28,6 +29,11 @@ private:
 	struct TileData {
 		QImage userpicFrame;
 		QImage blurredFrame;
+		QImage prepared;
+		qint64 preparedKey = 0;
+		int preparedIndex = -1;
+		int preparedRotation = 0;
+		crl::time preparedAt = 0;
 		bool stale = false;
 	};
 	void paintTile(
@@ -52,6 +58,15 @@ private:
 	void validateUserpicFrame(
 		not_null<VideoTile*> tile,
 		TileData &data);
+	void validatePreparedFrame(
+		not_null<VideoTile*> tile,
+		TileData &data,
+		const QImage &image,
+		int index,
+		int rotation,
+		QSize size);
+	void updateThrottledTile(not_null<VideoTile*> tile, crl::time when);
+	void updateThrottledTiles();
 
 	const not_null<Viewport*> _owner;
 
@@ -59,6 +74,8 @@ private:
 	bool _userpicFrame = false;
 	bool _pausedFrame = false;
 	base::flat_map<not_null<VideoTile*>, TileData> _tileData;
+	base::flat_set<not_null<VideoTile*>> _throttledTiles;
+	base::Timer _throttledTilesTimer;
 	Ui::CrossLineAnimation _pinIcon;
 	Ui::RoundRect _pinBackground;
 
@@ -8,6 +8,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "core/application.h"
 
 #include "extera/extera_lang.h"
+#include "extera/extera_settings.h"
 #include "data/data_abstract_structure.h"
 #include "data/data_photo.h"
 #include "data/data_document.h"
@@ -21,6 +22,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "base/qt_signal_producer.h"
 #include "base/timer.h"
 #include "base/unixtime.h"
+#include "core/core_memory_usage.h"
 #include "core/core_settings.h"
 #include "core/update_checker.h"
 #include "core/shortcuts.h"
@@ -69,6 +71,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "media/player/media_player_float.h"
 #include "media/clip/media_clip_reader.h" // For Media::Clip::Finish().
 #include "media/system_media_controls_manager.h"
+#include "media/streaming/media_streaming_slices_memory.h"
 #include "window/notifications_manager.h"
 #include "window/themes/window_theme.h"
 #include "window/window_lock_widgets.h"
@@ -134,6 +137,15 @@ void SetCrashAnnotationsGL() {
 #endif // Q_OS_WIN
 }
 
+void RefreshStreamingMemoryLimit() {
+	const auto megabytes = ::ExteraSettings::JsonSettings::GetInt(
+		"streaming_memory_limit");
+	using Media::Streaming::SlicesMemory;
+	SlicesMemory::SetLimit((megabytes > 0)
+		? (int64(megabytes) * 1024 * 1024)
+		: SlicesMemory::DefaultLimit());
+}
+
 } // namespace
 
 Application *Application::Instance = nullptr;
@@ -150,6 +162,7 @@ Application::Application()
 , _platformIntegration(Platform::Integration::Create())
 , _batterySaving(std::make_unique<base::BatterySaving>())
 , _databases(std::make_unique<Storage::Databases>())
+, _memoryUsage(std::make_unique<MemoryUsage>())
 , _animationsManager(std::make_unique<Ui::Animations::Manager>())
 , _clearEmojiImageLoaderTimer([=] { clearEmojiSourceImages(); })
 , _audio(std::make_unique<Media::Audio::Instance>())
@@ -191,6 +204,36 @@ Application::Application()
 			UpdateChecker().setMtproto(session);
 		}
 	}, _lifetime);
+
+	RefreshStreamingMemoryLimit();
+	::ExteraSettings::JsonSettings::Events(
+		"streaming_memory_limit"
+	) | rpl::start_with_next([] {
+		RefreshStreamingMemoryLimit();
+	}, _lifetime);
+
+	_lifetime.add(_memoryUsage->add({
+		.name = u"Streaming slices"_q,
+		.collect = [] {
+			using namespace Media::Streaming;
+			const auto statistics = SlicesMemory::Statistics();
+			return MemoryUsageValue{
+				.count = statistics.readers,
+				.bytes = statistics.used,
+			};
+		},
+	}));
+	_lifetime.add(_memoryUsage->add({
+		.name = u"Shared image pixmaps"_q,
+		.collect = [] {
+			const auto statistics = Image::SharedStatistics();
+			return MemoryUsageValue{
+				.count = statistics.count,
+				.bytes = statistics.bytes,
+			};
+		},
+		.trim = [] { Image::ClearShared(); },
+	}));
 }
 
 Application::~Application() {
@@ -106,6 +106,7 @@ namespace Core {
 struct LocalUrlHandler;
 class Settings;
 class Tray;
+class MemoryUsage;
 
 enum class LaunchState {
 	Running,
@@ -217,6 +218,10 @@ public:
 		return *_databases;
 	}
 
+	[[nodiscard]] MemoryUsage &memoryUsage() const {
+		return *_memoryUsage;
+	}
+
 	// Domain component.
 	[[nodiscard]] Main::Domain &domain() const {
 		return *_domain;
@@ -385,6 +390,9 @@ private:
 	const std::unique_ptr<base::BatterySaving> _batterySaving;
 
 	const std::unique_ptr<Storage::Databases> _databases;
+
+	// Should be destroyed after everything that registers in it.
+	const std::unique_ptr<MemoryUsage> _memoryUsage;
 	const std::unique_ptr<Ui::Animations::Manager> _animationsManager;
 	crl::object_on_queue<Stickers::EmojiImageLoader> _emojiImageLoader;
 	base::Timer _clearEmojiImageLoaderTimer;
@@ -0,0 +1,85 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "core/core_memory_usage.h"
+
+namespace Core {
+namespace {
+
+constexpr auto kLogTimeout = 10 * 60 * crl::time(1000);
+
+[[nodiscard]] QString FormatBytes(int64 bytes) {
+	return (bytes >= 1024 * 1024)
+		? u"%1 MB"_q.arg(bytes / float64(1024 * 1024), 0, 'f', 1)
+		: u"%1 KB"_q.arg(bytes / float64(1024), 0, 'f', 1);
+}
+
+} // namespace
+
+MemoryUsage::MemoryUsage()
+: _logTimer([=] { logByTimer(); }) {
+	_logTimer.callEach(kLogTimeout);
+}
+
+rpl::lifetime MemoryUsage::add(MemoryUsageSource &&source) {
+	Expects(source.collect != nullptr);
+
+	const auto id = ++_lastId;
+	_entries.push_back({ .id = id, .source = std::move(source) });
+	return rpl::lifetime([=] { remove(id); });
+}
+
+void MemoryUsage::remove(int id) {
+	_entries.erase(
+		ranges::remove(_entries, id, &Entry::id),
+		end(_entries));
+}
+
+std::vector<QString> MemoryUsage::collect() const {
+	auto result = std::vector<QString>();
+	result.reserve(_entries.size());
+	for (const auto &entry : _entries) {
+		const auto value = entry.source.collect();
+		result.push_back(value.bytes
+			? u"%1: %2 (%3)"_q.arg(entry.source.name).arg(
+				value.count).arg(FormatBytes(value.bytes))
+			: u"%1: %2"_q.arg(entry.source.name).arg(value.count));
+	}
+	return result;
+}
+
+QString MemoryUsage::report() const {
+	const auto lines = collect();
+	return lines.empty()
+		? u"Nothing is registered."_q
+		: QStringList(begin(lines), end(lines)).join('\n');
+}
+
+void MemoryUsage::trim() {
+	// The trim callbacks may add or remove sources.
+	auto callbacks = std::vector<Fn<void()>>();
+	for (const auto &entry : _entries) {
+		if (entry.source.trim) {
+			callbacks.push_back(entry.source.trim);
+		}
+	}
+	for (const auto &callback : callbacks) {
+		callback();
+	}
+	LOG(("Memory Usage: Trimmed %1 sources.").arg(callbacks.size()));
+}
+
+void MemoryUsage::logByTimer() {
+	if (!Logs::DebugEnabled()) {
+		return;
+	}
+	const auto lines = collect();
+	DEBUG_LOG(("Memory Usage: %1"
+		).arg(QStringList(begin(lines), end(lines)).join(u"; "_q)));
+}
+
+} // namespace Core
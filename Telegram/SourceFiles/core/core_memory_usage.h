@@ -0,0 +1,54 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#pragma once
+
+#include "base/timer.h"
+
+namespace Core {
+
+struct MemoryUsageValue {
+	int64 count = 0;
+	int64 bytes = 0; // Zero if the subsystem doesn't count bytes.
+};
+
+struct MemoryUsageSource {
+	QString name;
+	Fn<MemoryUsageValue()> collect;
+	Fn<void()> trim;
+};
+
+// Subsystems register what they keep in memory here. The sources are
+// asked to count it only when a report is requested, so registering
+// costs nothing while nobody is looking. Main thread only.
+class MemoryUsage final {
+public:
+	MemoryUsage();
+
+	// The source is removed when the returned lifetime is destroyed.
+	[[nodiscard]] rpl::lifetime add(MemoryUsageSource &&source);
+
+	[[nodiscard]] QString report() const;
+	void trim();
+
+private:
+	struct Entry {
+		int id = 0;
+		MemoryUsageSource source;
+	};
+
+	[[nodiscard]] std::vector<QString> collect() const;
+	void remove(int id);
+	void logByTimer();
+
+	std::vector<Entry> _entries;
+	int _lastId = 0;
+	base::Timer _logTimer;
+
+};
+
+} // namespace Core
@@ -0,0 +1,159 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "core/core_tracing.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+
+#include <chrono>
+
+namespace Core::Tracing {
+namespace {
+
+constexpr auto kEventsLimit = 1024 * 1024;
+
+enum class Phase : char {
+	Complete = 'X',
+	AsyncBegin = 'b',
+	AsyncEnd = 'e',
+};
+
+struct Event {
+	const char *name = nullptr;
+	int64 start = 0;
+	int64 duration = 0;
+	uint64 id = 0;
+	int thread = 0;
+	Phase phase = Phase::Complete;
+};
+
+struct State {
+	std::atomic<bool> enabled = false;
+	std::atomic<int> lastThread = 0;
+	QMutex mutex;
+	std::vector<Event> events;
+	int dropped = 0;
+};
+
+[[nodiscard]] State &Instance() {
+	static auto result = State();
+	return result;
+}
+
+[[nodiscard]] int CurrentThread() {
+	thread_local const auto result = ++Instance().lastThread;
+	return result;
+}
+
+void Push(Event &&event) {
+	event.thread = CurrentThread();
+
+	auto &state = Instance();
+	QMutexLocker lock(&state.mutex);
+	if (!state.enabled.load(std::memory_order_relaxed)) {
+		return;
+	} else if (state.events.size() >= kEventsLimit) {
+		++state.dropped;
+		return;
+	}
+	state.events.push_back(std::move(event));
+}
+
+[[nodiscard]] QByteArray Serialize(const Event &event) {
+	auto result = "{\"name\":\""
+		+ QByteArray(event.name)
+		+ "\",\"cat\":\"tdesktop\",\"ph\":\""
+		+ char(event.phase)
+		+ "\",\"ts\":"
+		+ QByteArray::number(event.start)
+		+ ",\"pid\":1,\"tid\":"
+		+ QByteArray::number(event.thread);
+	if (event.phase == Phase::Complete) {
+		result += ",\"dur\":" + QByteArray::number(event.duration);
+	} else {
+		result += ",\"id\":\"0x" + QByteArray::number(event.id, 16) + '"';
+	}
+	return result + '}';
+}
+
+} // namespace
+
+bool Enabled() {
+	return Instance().enabled.load(std::memory_order_relaxed);
+}
+
+int64 Now() {
+	using namespace std::chrono;
+	return duration_cast<microseconds>(
+		steady_clock::now().time_since_epoch()).count();
+}
+
+void Start() {
+	auto &state = Instance();
+	QMutexLocker lock(&state.mutex);
+	state.events.clear();
+	state.dropped = 0;
+	state.enabled.store(true, std::memory_order_relaxed);
+}
+
+bool Finish(const QString &path) {
+	auto &state = Instance();
+	auto events = std::vector<Event>();
+	auto dropped = 0;
+	{
+		QMutexLocker lock(&state.mutex);
+		state.enabled.store(false, std::memory_order_relaxed);
+		events = base::take(state.events);
+		dropped = base::take(state.dropped);
+	}
+	if (dropped) {
+		LOG(("Tracing Warning: %1 events dropped over the limit."
+			).arg(dropped));
+	}
+
+	QFile f(path);
+	if (!f.open(QIODevice::WriteOnly)) {
+		LOG(("Tracing Error: could not open '%1' for writing.").arg(path));
+		return false;
+	}
+	f.write("{\"traceEvents\":[\n");
+	auto first = true;
+	for (const auto &event : events) {
+		if (!first) {
+			f.write(",\n");
+		}
+		first = false;
+		f.write(Serialize(event));
+	}
+	f.write("\n],\"displayTimeUnit\":\"ms\"}\n");
+	return (f.error() == QFileDevice::NoError);
+}
+
+void Complete(const char *name, int64 start, int64 duration) {
+	Push({ .name = name, .start = start, .duration = duration });
+}
+
+void AsyncBegin(const char *name, uint64 id) {
+	Push({
+		.name = name,
+		.start = Now(),
+		.id = id,
+		.phase = Phase::AsyncBegin,
+	});
+}
+
+void AsyncEnd(const char *name, uint64 id) {
+	Push({
+		.name = name,
+		.start = Now(),
+		.id = id,
+		.phase = Phase::AsyncEnd,
+	});
+}
+
+} // namespace Core::Tracing
@@ -0,0 +1,75 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#pragma once
+
+// Scoped tracing of hot paths, exported in the Chrome trace event format.
+// Open the written file in chrome://tracing or ui.perfetto.dev.
+//
+// While tracing is not started every scope costs one relaxed atomic load.
+// Build with TDESKTOP_DISABLE_TRACING to remove the instrumentation.
+
+namespace Core::Tracing {
+
+[[nodiscard]] bool Enabled();
+
+void Start();
+// Stops tracing and writes the collected events, returns false on failure.
+bool Finish(const QString &path);
+
+// Names must be string literals, they are stored by pointer.
+void Complete(const char *name, int64 start, int64 duration);
+void AsyncBegin(const char *name, uint64 id);
+void AsyncEnd(const char *name, uint64 id);
+
+[[nodiscard]] int64 Now();
+
+class Scope final {
+public:
+	explicit Scope(const char *name)
+	: _name(Enabled() ? name : nullptr)
+	, _start(_name ? Now() : 0) {
+	}
+	Scope(const Scope &other) = delete;
+	Scope &operator=(const Scope &other) = delete;
+	~Scope() {
+		if (_name) {
+			Complete(_name, _start, Now() - _start);
+		}
+	}
+
+private:
+	const char *_name = nullptr;
+	int64 _start = 0;
+
+};
+
+} // namespace Core::Tracing
+
+#ifndef TDESKTOP_DISABLE_TRACING
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) \
+	const auto TRACE_CONCAT(trace_scope_, __LINE__) \
+		= ::Core::Tracing::Scope(name)
+#define TRACE_ASYNC_BEGIN(name, id) \
+	(::Core::Tracing::Enabled() \
+		? ::Core::Tracing::AsyncBegin(name, uint64(id)) \
+		: void())
+#define TRACE_ASYNC_END(name, id) \
+	(::Core::Tracing::Enabled() \
+		? ::Core::Tracing::AsyncEnd(name, uint64(id)) \
+		: void())
+
+#else // !TDESKTOP_DISABLE_TRACING
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_ASYNC_BEGIN(name, id) ((void)0)
+#define TRACE_ASYNC_END(name, id) ((void)0)
+
+#endif // TDESKTOP_DISABLE_TRACING
@@ -24,6 +24,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "window/themes/window_theme_preview.h"
 #include "core/core_settings.h"
 #include "core/application.h"
+#include "core/core_tracing.h"
 #include "storage/file_download.h"
 #include "ui/chat/attach/attach_prepare.h"
 #include "ui/image/image.h"
@@ -433,6 +434,8 @@ void DocumentMedia::GenerateGoodThumbnail(
 	}
 	const auto guard = base::make_weak(&document->owner().session());
 	crl::async([=, location = std::move(location)] {
+		TRACE_SCOPE("Data::PrepareGoodThumbnail");
+
 		const auto filepath = (location && location->accessEnable())
 			? location->name()
 			: QString();
@@ -492,6 +495,8 @@ void DocumentMedia::ReadOrGenerateThumbnail(
 			});
 		} else if (active) {
 			crl::async([=] {
+				TRACE_SCOPE("Data::ReadGoodThumbnail");
+
 				auto image = Images::Read({ .content = value }).image;
 				crl::on_main(guard, [=, image = std::move(image)]() mutable {
 					document->setGoodThumbnailChecked(true);
@@ -0,0 +1,168 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "data/data_messages_text_index.h"
+
+#include "history/history.h"
+#include "history/history_item.h"
+
+namespace Data {
+namespace {
+
+[[nodiscard]] std::vector<QString> PrepareWords(const QString &text) {
+	if (text.isEmpty()) {
+		return {};
+	}
+	const auto list = TextUtilities::PrepareSearchWords(text);
+	auto result = std::vector<QString>(list.begin(), list.end());
+	ranges::sort(result);
+	result.erase(ranges::unique(result), end(result));
+	return result;
+}
+
+[[nodiscard]] bool HasWordWithPrefix(
+		const std::vector<QString> &words,
+		const QString &prefix) {
+	const auto i = ranges::lower_bound(words, prefix);
+	return (i != end(words)) && i->startsWith(prefix);
+}
+
+} // namespace
+
+void MessagesTextIndex::add(not_null<HistoryItem*> item) {
+	if (!item->isRegular() || item->isSponsored() || item->isService()) {
+		return;
+	}
+	// Items without text are kept too, so that refresh() indexes them
+	// as soon as they get some text after an edit.
+	auto &words = _wordsByItem[item];
+	unindexWords(item, words);
+	indexWords(item, words);
+}
+
+void MessagesTextIndex::refresh(not_null<HistoryItem*> item) {
+	const auto i = _wordsByItem.find(item);
+	if (i != end(_wordsByItem)) {
+		unindexWords(item, i->second);
+		indexWords(item, i->second);
+	}
+}
+
+void MessagesTextIndex::remove(not_null<HistoryItem*> item) {
+	const auto i = _wordsByItem.find(item);
+	if (i != end(_wordsByItem)) {
+		unindexWords(item, i->second);
+		_wordsByItem.erase(i);
+	}
+}
+
+void MessagesTextIndex::clear() {
+	_wordsByItem.clear();
+	_itemsByWord.clear();
+}
+
+void MessagesTextIndex::indexWords(
+		not_null<HistoryItem*> item,
+		std::vector<QString> &to) {
+	to = PrepareWords(item->originalText().text);
+	for (const auto &word : to) {
+		_itemsByWord[word].emplace(item);
+	}
+}
+
+void MessagesTextIndex::unindexWords(
+		not_null<HistoryItem*> item,
+		const std::vector<QString> &words) {
+	for (const auto &word : words) {
+		const auto i = _itemsByWord.find(word);
+		if (i != end(_itemsByWord)) {
+			i->second.erase(item);
+			if (i->second.empty()) {
+				_itemsByWord.erase(i);
+			}
+		}
+	}
+}
+
+std::vector<not_null<HistoryItem*>> MessagesTextIndex::search(
+		const MessagesTextQuery &query) const {
+	auto result = std::vector<not_null<HistoryItem*>>();
+	const auto words = PrepareWords(query.query);
+	if (words.empty()) {
+		return result;
+	}
+
+	// Take candidates from the query word with the fewest matches.
+	struct Range {
+		std::map<QString, Items>::const_iterator from;
+		std::map<QString, Items>::const_iterator till;
+		size_t count = 0;
+	};
+	auto rarest = std::optional<Range>();
+	for (const auto &word : words) {
+		auto range = Range{ _itemsByWord.lower_bound(word) };
+		range.till = range.from;
+		for (; range.till != end(_itemsByWord); ++range.till) {
+			if (!range.till->first.startsWith(word)) {
+				break;
+			}
+			range.count += range.till->second.size();
+		}
+		if (!range.count) {
+			return result;
+		} else if (!rarest || rarest->count > range.count) {
+			rarest = range;
+		}
+	}
+	const auto good = [&](not_null<HistoryItem*> item) {
+		if (query.history && item->history() != query.history) {
+			return false;
+		} else if (query.topicRootId
+			&& item->topicRootId() != query.topicRootId) {
+			return false;
+		} else if (query.from && item->from() != query.from) {
+			return false;
+		}
+		const auto i = _wordsByItem.find(item);
+		Assert(i != end(_wordsByItem));
+		for (const auto &word : words) {
+			if (!HasWordWithPrefix(i->second, word)) {
+				return false;
+			}
+		}
+		return true;
+	};
+	for (auto i = rarest->from; i != rarest->till; ++i) {
+		for (const auto &item : i->second) {
+			if (good(item)) {
+				result.push_back(item);
+			}
+		}
+	}
+	ranges::sort(result);
+	result.erase(ranges::unique(result), end(result));
+
+	const auto newer = [](
+			not_null<HistoryItem*> a,
+			not_null<HistoryItem*> b) {
+		return (a->date() != b->date())
+			? (a->date() > b->date())
+			: (a->id > b->id);
+	};
+	if (query.limit > 0 && int(result.size()) > query.limit) {
+		ranges::partial_sort(
+			result,
+			begin(result) + query.limit,
+			newer);
+		result.erase(begin(result) + query.limit, end(result));
+	} else {
+		ranges::sort(result, newer);
+	}
+	return result;
+}
+
+} // namespace Data
@@ -0,0 +1,54 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#pragma once
+
+class History;
+class HistoryItem;
+class PeerData;
+
+namespace Data {
+
+struct MessagesTextQuery {
+	QString query;
+	History *history = nullptr;
+	MsgId topicRootId = 0;
+	PeerData *from = nullptr;
+	int limit = 0;
+};
+
+// Inverted index over the text of all messages loaded in the session.
+// Every query word should be a prefix of some word in the message text.
+// Only the messages that the server search could return are indexed,
+// local messages are added when they're sent and get their real id.
+class MessagesTextIndex final {
+public:
+	void add(not_null<HistoryItem*> item);
+	void refresh(not_null<HistoryItem*> item);
+	void remove(not_null<HistoryItem*> item);
+	void clear();
+
+	// Newest messages go first.
+	[[nodiscard]] std::vector<not_null<HistoryItem*>> search(
+		const MessagesTextQuery &query) const;
+
+private:
+	using Items = std::unordered_set<not_null<HistoryItem*>>;
+
+	void indexWords(not_null<HistoryItem*> item, std::vector<QString> &to);
+	void unindexWords(
+		not_null<HistoryItem*> item,
+		const std::vector<QString> &words);
+
+	std::unordered_map<
+		not_null<HistoryItem*>,
+		std::vector<QString>> _wordsByItem;
+	std::map<QString, Items> _itemsByWord;
+
+};
+
+} // namespace Data
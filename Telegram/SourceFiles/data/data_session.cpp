@@ -17,6 +17,8 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "api/api_text_entities.h"
 #include "api/api_user_names.h"
 #include "core/application.h"
+#include "core/core_memory_usage.h"
+#include "core/core_tracing.h"
 #include "core/core_settings.h"
 #include "core/mime_type.h" // Core::IsMimeSticker
 #include "core/crash_reports.h" // CrashReports::SetAnnotation
@@ -52,7 +54,9 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "data/data_file_origin.h"
 #include "data/data_download_manager.h"
 #include "data/data_photo.h"
+#include "data/data_photo_media.h"
 #include "data/data_document.h"
+#include "data/data_document_media.h"
 #include "data/data_web_page.h"
 #include "data/data_wall_paper.h"
 #include "data/data_game.h"
@@ -69,6 +73,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "data/data_streaming.h"
 #include "data/data_media_rotation.h"
 #include "data/data_histories.h"
+#include "data/data_messages_text_index.h"
 #include "data/data_peer_values.h"
 #include "data/data_premium_limits.h"
 #include "data/data_forum.h"
@@ -259,6 +264,7 @@ Session::Session(not_null<Main::Session*> session)
 , _sendActionManager(std::make_unique<SendActionManager>())
 , _streaming(std::make_unique<Streaming>(this))
 , _mediaRotation(std::make_unique<MediaRotation>())
+, _messagesTextIndex(std::make_unique<MessagesTextIndex>())
 , _histories(std::make_unique<Histories>(this))
 , _stickers(std::make_unique<Stickers>(this))
 , _sponsoredMessages(std::make_unique<SponsoredMessages>(this))
@@ -282,6 +288,7 @@ Session::Session(not_null<Main::Session*> session)
 	setupChannelLeavingViewer();
 	setupPeerNameViewer();
 	setupUserIsContactViewer();
+	setupMemoryUsage();
 
 	_chatsList.unreadStateChanges(
 	) | rpl::start_with_next([=] {
@@ -377,6 +384,7 @@ void Session::clear() {
 	_dependentMessages.clear();
 	base::take(_messages);
 	base::take(_nonChannelMessages);
+	_messagesTextIndex->clear();
 	_messageByRandomId.clear();
 	_sentMessagesData.clear();
 	cSetRecentInlineBots(RecentInlineBots());
@@ -986,6 +994,8 @@ not_null<PeerData*> Session::processChat(const MTPChat &data) {
 }
 
 UserData *Session::processUsers(const MTPVector<MTPUser> &data) {
+	TRACE_SCOPE("Data::Session::processUsers");
+
 	auto result = (UserData*)nullptr;
 	for (const auto &user : data.v) {
 		result = processUser(user);
@@ -994,6 +1004,8 @@ UserData *Session::processUsers(const MTPVector<MTPUser> &data) {
 }
 
 PeerData *Session::processChats(const MTPVector<MTPChat> &data) {
+	TRACE_SCOPE("Data::Session::processChats");
+
 	auto result = (PeerData*)nullptr;
 	for (const auto &chat : data.v) {
 		result = processChat(chat);
@@ -1376,6 +1388,85 @@ void Session::setupPeerNameViewer() {
 	}, _lifetime);
 }
 
+void Session::setupMemoryUsage() {
+	const auto imageBytes = [](base::flat_set<Image*> images) {
+		auto result = int64();
+		for (const auto image : images) {
+			if (image) {
+				result += int64(image->width()) * image->height() * 4;
+			}
+		}
+		return result;
+	};
+	auto &usage = Core::App().memoryUsage();
+	_lifetime.add(usage.add({
+		.name = u"Messages"_q,
+		.collect = [=] {
+			auto result = Core::MemoryUsageValue();
+			for (const auto &[peerId, messages] : _messages) {
+				result.count += messages.size();
+			}
+			return result;
+		},
+	}));
+	_lifetime.add(usage.add({
+		.name = u"Message views"_q,
+		.collect = [=] {
+			auto result = Core::MemoryUsageValue();
+			for (const auto &[item, views] : _views) {
+				result.count += views.size();
+			}
+			return result;
+		},
+	}));
+	_lifetime.add(usage.add({
+		.name = u"Heavy view parts"_q,
+		.collect = [=] {
+			return Core::MemoryUsageValue{
+				.count = int64(_heavyViewParts.size()),
+			};
+		},
+		.trim = [=] {
+			for (const auto &view : base::take(_heavyViewParts)) {
+				view->unloadHeavyPart();
+			}
+		},
+	}));
+	_lifetime.add(usage.add({
+		.name = u"Photo images"_q,
+		.collect = [=] {
+			auto result = Core::MemoryUsageValue();
+			for (const auto &[id, photo] : _photos) {
+				if (const auto media = photo->activeMediaView()) {
+					++result.count;
+					result.bytes += imageBytes({
+						media->image(PhotoSize::Small),
+						media->image(PhotoSize::Thumbnail),
+						media->image(PhotoSize::Large),
+					});
+				}
+			}
+			return result;
+		},
+	}));
+	_lifetime.add(usage.add({
+		.name = u"Document thumbnails and bytes"_q,
+		.collect = [=] {
+			auto result = Core::MemoryUsageValue();
+			for (const auto &[id, document] : _documents) {
+				if (const auto media = document->activeMediaView()) {
+					++result.count;
+					result.bytes += media->bytes().size() + imageBytes({
+						media->thumbnail(),
+						media->goodThumbnail(),
+					});
+				}
+			}
+			return result;
+		},
+	}));
+}
+
 void Session::setupUserIsContactViewer() {
 	session().changes().peerUpdates(
 		PeerUpdate::Flag::IsContact
@@ -1607,6 +1698,9 @@ void Session::notifyItemIdChange(IdChange event) {
 	_itemIdChanges.fire_copy(event);
 
 	if (item) {
+		// Sent messages become regular only now, so index them here.
+		_messagesTextIndex->add(item);
+
 		const auto refreshViewDataId = [](not_null<ViewElement*> view) {
 			view->refreshDataId();
 		};
@@ -2174,6 +2268,8 @@ void Session::updateEditedMessage(const MTPMessage &data) {
 void Session::processMessages(
 		const QVector<MTPMessage> &data,
 		NewMessageType type) {
+	TRACE_SCOPE("Data::Session::processMessages");
+
 	auto indices = base::flat_map<uint64, int>();
 	for (int i = 0, l = data.size(); i != l; ++i) {
 		const auto &message = data[i];
@@ -2243,6 +2339,7 @@ void Session::registerMessage(not_null<HistoryItem*> item) {
 		i->second->destroy();
 	}
 	list->emplace(itemId, item);
+	_messagesTextIndex->add(item);
 
 	if (!peerIsChannel(peerId) && IsServerMsgId(itemId)) {
 		_nonChannelMessages.emplace(itemId, item);
@@ -2372,6 +2469,7 @@ void Session::unregisterMessage(not_null<HistoryItem*> item) {
 	groups().unregisterMessage(item);
 	removeDependencyMessage(item);
 	messagesListForInsert(peerId)->erase(itemId);
+	_messagesTextIndex->remove(item);
 
 	if (!peerIsChannel(peerId) && IsServerMsgId(itemId)) {
 		_nonChannelMessages.erase(itemId);
@@ -57,6 +57,7 @@ class CloudThemes;
 class Streaming;
 class MediaRotation;
 class Histories;
+class MessagesTextIndex;
 class DocumentMedia;
 class PhotoMedia;
 class Stickers;
@@ -115,6 +116,9 @@ public:
 	[[nodiscard]] Histories &histories() const {
 		return *_histories;
 	}
+	[[nodiscard]] MessagesTextIndex &messagesTextIndex() const {
+		return *_messagesTextIndex;
+	}
 	[[nodiscard]] Stickers &stickers() const {
 		return *_stickers;
 	}
@@ -725,6 +729,7 @@ private:
 	void setupChannelLeavingViewer();
 	void setupPeerNameViewer();
 	void setupUserIsContactViewer();
+	void setupMemoryUsage();
 
 	void checkSelfDestructItems();
 	void checkLocalUsersWentOffline();
@@ -999,6 +1004,7 @@ private:
 	const std::unique_ptr<SendActionManager> _sendActionManager;
 	const std::unique_ptr<Streaming> _streaming;
 	const std::unique_ptr<MediaRotation> _mediaRotation;
+	const std::unique_ptr<MessagesTextIndex> _messagesTextIndex;
 	const std::unique_ptr<Histories> _histories;
 	const std::unique_ptr<Stickers> _stickers;
 	std::unique_ptr<SponsoredMessages> _sponsoredMessages;
@@ -26,6 +26,8 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "ui/text/text_custom_emoji.h"
 #include "ui/text/text_utilities.h"
 #include "ui/ui_utility.h"
+#include "core/application.h"
+#include "core/core_memory_usage.h"
 #include "apiwrap.h"
 #include "styles/style_chat.h"
 #include "styles/style_chat_helpers.h"
@@ -34,6 +36,8 @@ namespace Data {
 namespace {
 
 constexpr auto kMaxPerRequest = 100;
+constexpr auto kUnusedInstancesLimit = 256;
+constexpr auto kTrimUnusedDelay = 5 * crl::time(1000);
 #if 0 // inject-to-on_main
 constexpr auto kUnsubscribeUpdatesDelay = 3 * crl::time(1000);
 #endif
@@ -56,6 +60,58 @@ private:
 
 };
 
+// Lets CustomEmojiManager know when the shared instance is not used.
+class TrackedEmoji final : public Ui::Text::CustomEmoji {
+public:
+	TrackedEmoji(
+		std::unique_ptr<Ui::Text::CustomEmoji> wrapped,
+		Fn<void()> released);
+	~TrackedEmoji();
+
+	QString entityData() override;
+	void paint(QPainter &p, const Context &context) override;
+	void unload() override;
+	bool ready() override;
+	bool readyInDefaultState() override;
+
+private:
+	std::unique_ptr<Ui::Text::CustomEmoji> _wrapped;
+	const Fn<void()> _released;
+
+};
+
+TrackedEmoji::TrackedEmoji(
+	std::unique_ptr<Ui::Text::CustomEmoji> wrapped,
+	Fn<void()> released)
+: _wrapped(std::move(wrapped))
+, _released(std::move(released)) {
+}
+
+TrackedEmoji::~TrackedEmoji() {
+	_wrapped = nullptr;
+	_released();
+}
+
+QString TrackedEmoji::entityData() {
+	return _wrapped->entityData();
+}
+
+void TrackedEmoji::paint(QPainter &p, const Context &context) {
+	_wrapped->paint(p, context);
+}
+
+void TrackedEmoji::unload() {
+	_wrapped->unload();
+}
+
+bool TrackedEmoji::ready() {
+	return _wrapped->ready();
+}
+
+bool TrackedEmoji::readyInDefaultState() {
+	return _wrapped->readyInDefaultState();
+}
+
 [[nodiscard]] ChatHelpers::StickerLottieSize LottieSizeFromTag(SizeTag tag) {
 	// NB! onlyCustomEmoji dimensions caching uses last ::EmojiInteraction-s.
 	using LottieSize = ChatHelpers::StickerLottieSize;
@@ -414,6 +470,7 @@ Ui::CustomEmoji::Preview CustomEmojiLoader::preview() {
 
 CustomEmojiManager::CustomEmojiManager(not_null<Session*> owner)
 : _owner(owner)
+, _trimUnusedTimer([=] { trimUnused(kUnusedInstancesLimit); })
 , _repaintTimer([=] { invokeRepaints(); }) {
 	const auto appConfig = &owner->session().account().appConfig();
 	appConfig->value(
@@ -427,6 +484,8 @@ CustomEmojiManager::CustomEmojiManager(not_null<Session*> owner)
 			_coloredSetId = setId;
 		}
 	}, _lifetime);
+
+	setupMemoryUsage();
 }
 
 CustomEmojiManager::~CustomEmojiManager() = default;
@@ -439,7 +498,8 @@ std::unique_ptr<Ui::Text::CustomEmoji> CustomEmojiManager::create(
 		int sizeOverride,
 		LoaderFactory factory) {
 	auto &instances = _instances[SizeIndex(tag)];
-	auto i = instances.find(documentId);
+	const auto key = InstanceKey{ documentId, sizeOverride };
+	auto i = instances.find(key);
 	if (i == end(instances)) {
 		using Loading = Ui::CustomEmoji::Loading;
 		const auto repaint = [=](
@@ -448,24 +508,91 @@ std::unique_ptr<Ui::Text::CustomEmoji> CustomEmojiManager::create(
 			repaintLater(instance, request);
 		};
 		auto [loader, setId, colored] = factory();
-		i = instances.emplace(
-			documentId,
-			std::make_unique<Ui::CustomEmoji::Instance>(Loading{
+		i = instances.emplace(key, InstanceEntry{
+			.instance = std::make_unique<Ui::CustomEmoji::Instance>(Loading{
 				std::move(loader),
 				prepareNonExactPreview(documentId, tag, sizeOverride)
-			}, std::move(repaint))).first;
+			}, std::move(repaint)),
+		}).first;
 		if (colored) {
-			i->second->setColored();
+			i->second.instance->setColored();
 		}
-	} else if (!i->second->hasImagePreview()) {
+	} else if (!i->second.instance->hasImagePreview()) {
 		auto preview = prepareNonExactPreview(documentId, tag, sizeOverride);
 		if (preview.isImage()) {
-			i->second->updatePreview(std::move(preview));
+			i->second.instance->updatePreview(std::move(preview));
+		}
+	}
+	if (!i->second.usage++) {
+		if (i->second.lastUsed) {
+			--_unusedInstances;
 		}
 	}
-	return std::make_unique<Ui::CustomEmoji::Object>(
-		i->second.get(),
-		std::move(update));
+	return std::make_unique<TrackedEmoji>(
+		std::make_unique<Ui::CustomEmoji::Object>(
+			i->second.instance.get(),
+			std::move(update)),
+		crl::guard(this, [=] { released(tag, key); }));
+}
+
+void CustomEmojiManager::released(SizeTag tag, InstanceKey key) {
+	auto &instances = _instances[SizeIndex(tag)];
+	const auto i = instances.find(key);
+	Assert(i != end(instances));
+	Assert(i->second.usage > 0);
+
+	i->second.lastUsed = crl::now();
+	if (!--i->second.usage
+		&& ++_unusedInstances > kUnusedInstancesLimit
+		&& !_trimUnusedTimer.isActive()) {
+		_trimUnusedTimer.callOnce(kTrimUnusedDelay);
+	}
+}
+
+void CustomEmojiManager::trimUnused(int keep) {
+	if (_unusedInstances <= keep) {
+		return;
+	}
+	struct Unused {
+		crl::time lastUsed = 0;
+		int index = 0;
+		InstanceKey key;
+	};
+	auto list = std::vector<Unused>();
+	list.reserve(_unusedInstances);
+	for (auto index = 0; index != kSizeCount; ++index) {
+		for (const auto &[key, entry] : _instances[index]) {
+			if (!entry.usage) {
+				list.push_back({ entry.lastUsed, index, key });
+			}
+		}
+	}
+	Assert(int(list.size()) == _unusedInstances);
+
+	// The instances unused for the longest time are destroyed first.
+	const auto remove = int(list.size()) - keep;
+	ranges::nth_element(list, begin(list) + remove, ranges::less(), [](
+			const Unused &entry) {
+		return entry.lastUsed;
+	});
+	for (auto i = begin(list), e = begin(list) + remove; i != e; ++i) {
+		_instances[i->index].remove(i->key);
+	}
+	_unusedInstances = keep;
+}
+
+void CustomEmojiManager::setupMemoryUsage() {
+	_lifetime.add(Core::App().memoryUsage().add({
+		.name = u"Custom emoji instances"_q,
+		.collect = [=] {
+			auto result = Core::MemoryUsageValue();
+			for (const auto &instances : _instances) {
+				result.count += instances.size();
+			}
+			return result;
+		},
+		.trim = [=] { trimUnused(0); },
+	}));
 }
 
 Ui::Text::CustomEmojiFactory CustomEmojiManager::factory(
@@ -480,24 +607,26 @@ Ui::CustomEmoji::Preview CustomEmojiManager::prepareNonExactPreview(
 		DocumentId documentId,
 		SizeTag tag,
 		int sizeOverride) const {
+	const auto size = FrameSizeFromTag(tag, sizeOverride);
 	for (auto i = _instances.size(); i != 0;) {
-		if (SizeIndex(tag) == --i) {
-			continue;
-		}
-		const auto &other = _instances[i];
-		const auto j = other.find(documentId);
-		if (j == end(other)) {
-			continue;
-		} else if (const auto nonExact = j->second->imagePreview()) {
-			const auto size = FrameSizeFromTag(tag, sizeOverride);
-			return {
-				nonExact.image().scaled(
-					size,
-					size,
-					Qt::IgnoreAspectRatio,
-					Qt::SmoothTransformation),
-				false,
-			};
+		const auto &other = _instances[--i];
+		auto j = other.lower_bound(InstanceKey{ documentId });
+		for (; j != end(other) && j->first.id == documentId; ++j) {
+			const auto exact = (SizeIndex(tag) == i)
+				&& (j->first.sizeOverride == sizeOverride);
+			const auto instance = j->second.instance.get();
+			if (exact) {
+				continue;
+			} else if (const auto nonExact = instance->imagePreview()) {
+				return {
+					nonExact.image().scaled(
+						size,
+						size,
+						Qt::IgnoreAspectRatio,
+						Qt::SmoothTransformation),
+					false,
+				};
+			}
 		}
 	}
 	return {};
@@ -686,9 +815,9 @@ void CustomEmojiManager::fillColoredFlags(not_null<DocumentData*> document) {
 	if (document->emojiUsesTextColor()) {
 		const auto id = document->id;
 		for (auto &instances : _instances) {
-			const auto i = instances.find(id);
-			if (i != end(instances)) {
-				i->second->setColored();
+			auto i = instances.lower_bound(InstanceKey{ id });
+			for (; i != end(instances) && i->first.id == id; ++i) {
+				i->second.instance->setColored();
 			}
 		}
 	}
@@ -88,6 +88,19 @@ public:
 private:
 	static constexpr auto kSizeCount = int(SizeTag::kCount);
 
+	// The instances are shared by all the emoji objects of the same
+	// document and size, they keep the decoded frames of the document.
+	struct InstanceKey {
+		DocumentId id = 0;
+		int sizeOverride = 0;
+
+		friend inline auto operator<=>(InstanceKey, InstanceKey) = default;
+	};
+	struct InstanceEntry {
+		std::unique_ptr<Ui::CustomEmoji::Instance> instance;
+		crl::time lastUsed = 0;
+		int usage = 0;
+	};
 	struct RepaintBunch {
 		crl::time when = 0;
 		std::vector<base::weak_ptr<Ui::CustomEmoji::Instance>> instances;
@@ -119,6 +132,9 @@ private:
 	void processLoaders(not_null<DocumentData*> document);
 	void processListeners(not_null<DocumentData*> document);
 	void requestSetFor(not_null<DocumentData*> document);
+	void released(SizeTag tag, InstanceKey key);
+	void trimUnused(int keep);
+	void setupMemoryUsage();
 
 	[[nodiscard]] Ui::CustomEmoji::Preview prepareNonExactPreview(
 		DocumentId documentId,
@@ -136,10 +152,10 @@ private:
 	const not_null<Session*> _owner;
 
 	std::array<
-		base::flat_map<
-			DocumentId,
-			std::unique_ptr<Ui::CustomEmoji::Instance>>,
+		base::flat_map<InstanceKey, InstanceEntry>,
 		kSizeCount> _instances;
+	int _unusedInstances = 0;
+	base::Timer _trimUnusedTimer;
 	std::array<
 		base::flat_map<
 			DocumentId,
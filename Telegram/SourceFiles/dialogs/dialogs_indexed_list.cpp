@@ -12,6 +12,23 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "history/history.h"
 
 namespace Dialogs {
+namespace {
+
+constexpr auto kTrigramLength = 3;
+
+template <typename Callback>
+void EnumerateTrigrams(const QString &word, Callback &&callback) {
+	for (auto i = 0, till = int(word.size()) - kTrigramLength; i <= till; ++i) {
+		callback(word.mid(i, kTrigramLength));
+	}
+}
+
+void SortUnique(std::vector<Key> &keys) {
+	ranges::sort(keys);
+	keys.erase(ranges::unique(keys), end(keys));
+}
+
+} // namespace
 
 IndexedList::IndexedList(SortMode sortMode, FilterId filterId)
 : _sortMode(sortMode)
@@ -26,6 +43,7 @@ RowsByLetter IndexedList::addToEnd(Key key) {
 	}
 
 	auto result = RowsByLetter{ _list.addToEnd(key) };
+	indexNameWords(key);
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
 		auto j = _index.find(ch);
 		if (j == _index.cend()) {
@@ -42,6 +60,7 @@ Row *IndexedList::addByName(Key key) {
 	}
 
 	const auto result = _list.addByName(key);
+	indexNameWords(key);
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
 		auto j = _index.find(ch);
 		if (j == _index.cend()) {
@@ -127,6 +146,9 @@ void IndexedList::adjustByName(
 	const auto mainRow = _list.adjustByName(key);
 	if (!mainRow) return;
 
+	unindexNameWords(key);
+	indexNameWords(key);
+
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
@@ -164,6 +186,9 @@ void IndexedList::adjustNames(
 	auto mainRow = _list.getRow(key);
 	if (!mainRow) return;
 
+	unindexNameWords(key);
+	indexNameWords(key);
+
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
@@ -194,8 +219,61 @@ void IndexedList::adjustNames(
 	}
 }
 
+void IndexedList::nameWordsChanged(Key key) {
+	if (_list.contains(key)) {
+		unindexNameWords(key);
+		indexNameWords(key);
+	}
+}
+
+void IndexedList::indexNameWords(Key key) {
+	const auto &words = key.entry()->chatListNameWords();
+	if (words.empty()) {
+		return;
+	}
+	_nameWords.emplace(key, words);
+	for (const auto &word : words) {
+		auto &keys = _byNameWord[word];
+		if (keys.empty()) {
+			EnumerateTrigrams(word, [&](QString &&trigram) {
+				_byTrigram[std::move(trigram)].emplace(word);
+			});
+		}
+		keys.emplace(key);
+	}
+}
+
+void IndexedList::unindexNameWords(Key key) {
+	const auto i = _nameWords.find(key);
+	if (i == end(_nameWords)) {
+		return;
+	}
+	for (const auto &word : i->second) {
+		const auto j = _byNameWord.find(word);
+		if (j == end(_byNameWord)) {
+			continue;
+		}
+		j->second.remove(key);
+		if (!j->second.empty()) {
+			continue;
+		}
+		_byNameWord.erase(j);
+		EnumerateTrigrams(word, [&](QString &&trigram) {
+			const auto k = _byTrigram.find(trigram);
+			if (k != end(_byTrigram)) {
+				k->second.remove(word);
+				if (k->second.empty()) {
+					_byTrigram.erase(k);
+				}
+			}
+		});
+	}
+	_nameWords.erase(i);
+}
+
 void IndexedList::remove(Key key, Row *replacedBy) {
 	if (_list.remove(key, replacedBy)) {
+		unindexNameWords(key);
 		for (const auto &ch : key.entry()->chatListFirstLetters()) {
 			if (const auto it = _index.find(ch); it != _index.cend()) {
 				it->second.remove(key, replacedBy);
@@ -207,55 +285,93 @@ void IndexedList::remove(Key key, Row *replacedBy) {
 void IndexedList::clear() {
 	_list.clear();
 	_index.clear();
+	_nameWords.clear();
+	_byNameWord.clear();
+	_byTrigram.clear();
+}
+
+void IndexedList::findNameWord(
+		const QString &word,
+		std::vector<Key> &prefix,
+		std::vector<Key> &any) const {
+	prefix.clear();
+	any.clear();
+	for (auto i = _byNameWord.lower_bound(word)
+		; i != end(_byNameWord) && i->first.startsWith(word)
+		; ++i) {
+		prefix.insert(end(prefix), begin(i->second), end(i->second));
+	}
+	SortUnique(prefix);
+	any = prefix;
+	if (word.size() < kTrigramLength) {
+		return;
+	}
+
+	// Check only the name words having the rarest trigram of the word.
+	auto rarest = (const base::flat_set<QString>*)nullptr;
+	for (auto i = 0, till = int(word.size()) - kTrigramLength; i <= till; ++i) {
+		const auto j = _byTrigram.find(word.mid(i, kTrigramLength));
+		if (j == end(_byTrigram)) {
+			return;
+		} else if (!rarest || rarest->size() > j->second.size()) {
+			rarest = &j->second;
+		}
+	}
+	for (const auto &name : *rarest) {
+		if (!name.startsWith(word) && name.contains(word)) {
+			const auto &keys = _byNameWord.find(name)->second;
+			any.insert(end(any), begin(keys), end(keys));
+		}
+	}
+	SortUnique(any);
 }
 
 std::vector<not_null<Row*>> IndexedList::filtered(
 		const QStringList &words) const {
-	const auto minimal = [&]() -> const Dialogs::List* {
-		if (empty()) {
-			return nullptr;
+	auto result = std::vector<not_null<Row*>>();
+	if (empty()) {
+		return result;
+	}
+	auto prefix = std::optional<std::vector<Key>>();
+	auto any = std::optional<std::vector<Key>>();
+	auto wordPrefix = std::vector<Key>();
+	auto wordAny = std::vector<Key>();
+	const auto intersect = [](
+			std::optional<std::vector<Key>> &already,
+			const std::vector<Key> &found) {
+		if (!already) {
+			already = found;
+			return;
 		}
-		auto result = (const Dialogs::List*)nullptr;
-		for (const auto &word : words) {
-			if (word.isEmpty()) {
-				continue;
-			}
-			const auto found = filtered(word[0]);
-			if (!found || found->empty()) {
-				return nullptr;
-			} else if (!result || result->size() > found->size()) {
-				result = found;
-			}
+		auto both = std::vector<Key>();
+		ranges::set_intersection(*already, found, std::back_inserter(both));
+		*already = std::move(both);
+	};
+	for (const auto &word : words) {
+		if (word.isEmpty()) {
+			continue;
 		}
-		return result;
-	}();
-	auto result = std::vector<not_null<Row*>>();
-	if (!minimal || minimal->empty()) {
+		findNameWord(word, wordPrefix, wordAny);
+		intersect(prefix, wordPrefix);
+		intersect(any, wordAny);
+		if (any->empty()) {
+			return result;
+		}
+	}
+	if (!any) {
 		return result;
 	}
-	result.reserve(minimal->size());
-	for (const auto &row : *minimal) {
-		const auto &nameWords = row->entry()->chatListNameWords();
-		const auto found = [&](const QString &word) {
-			for (const auto &name : nameWords) {
-				if (name.startsWith(word)) {
-					return true;
-				}
-			}
-			return false;
-		};
-		const auto allFound = [&] {
-			for (const auto &word : words) {
-				if (!found(word)) {
-					return false;
-				}
-			}
-			return true;
-		}();
-		if (allFound) {
+	result.reserve(any->size());
+	for (const auto &key : *any) {
+		if (const auto row = _list.getRow(key)) {
 			result.push_back(row);
 		}
 	}
+	const auto rank = [&](not_null<Row*> row) {
+		const auto infix = !ranges::binary_search(*prefix, row->key());
+		return std::make_pair(infix ? 1 : 0, row->index());
+	};
+	ranges::sort(result, ranges::less(), rank);
 	return result;
 }
 
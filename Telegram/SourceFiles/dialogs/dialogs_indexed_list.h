@@ -39,6 +39,9 @@ public:
 		not_null<PeerData*> peer,
 		const base::flat_set<QChar> &oldChars);
 
+	// For entries without peerNameChanged() notifications, like topics.
+	void nameWordsChanged(Key key);
+
 	void remove(Key key, Row *replacedBy = nullptr);
 	void clear();
 
@@ -49,6 +52,10 @@ public:
 		const auto i = _index.find(ch);
 		return (i != _index.end()) ? &i->second : nullptr;
 	}
+
+	// Rows having all the words as prefixes of their name words go first,
+	// then rows where some words (at least three letters long) were
+	// found only inside the name words. Both parts keep all() order.
 	[[nodiscard]] std::vector<not_null<Row*>> filtered(
 		const QStringList &words) const;
 
@@ -91,11 +98,24 @@ private:
 		not_null<History*> history,
 		const base::flat_set<QChar> &oldChars);
 
+	void indexNameWords(Key key);
+	void unindexNameWords(Key key);
+	void findNameWord(
+		const QString &word,
+		std::vector<Key> &prefix,
+		std::vector<Key> &any) const;
+
 	SortMode _sortMode = SortMode();
 	FilterId _filterId = 0;
 	List _list, _empty;
 	base::flat_map<QChar, List> _index;
 
+	// Name words of all entries for prefix lookup and their trigrams
+	// for infix lookup, updated together with _index.
+	std::map<Key, base::flat_set<QString>> _nameWords;
+	std::map<QString, base::flat_set<Key>> _byNameWord;
+	std::map<QString, base::flat_set<QString>> _byTrigram;
+
 };
 
 } // namespace Dialogs
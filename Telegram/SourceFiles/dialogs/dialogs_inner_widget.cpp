@@ -16,6 +16,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "history/history_item.h"
 #include "core/shortcuts.h"
 #include "core/application.h"
+#include "core/core_tracing.h"
 #include "ui/widgets/buttons.h"
 #include "ui/widgets/popup_menu.h"
 #include "ui/text/text_utilities.h"
@@ -542,6 +543,8 @@ void InnerWidget::changeOpenedForum(Data::Forum *forum) {
 }
 
 void InnerWidget::paintEvent(QPaintEvent *e) {
+	TRACE_SCOPE("Dialogs::InnerWidget::paintEvent");
+
 	Painter p(this);
 
 	p.setInactive(
@@ -53,6 +53,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "storage/storage_account.h"
 #include "storage/storage_domain.h"
 #include "data/data_session.h"
+#include "data/data_messages_text_index.h"
 #include "data/data_channel.h"
 #include "data/data_chat.h"
 #include "data/data_user.h"
@@ -1437,6 +1438,7 @@ bool Widget::searchMessages(bool searchCache) {
 			}).send();
 			_searchQueries.emplace(_searchRequest, _searchQuery);
 		}
+		searchLocalMessages();
 	}
 	const auto query = Api::ConvertPeerSearchQuery(q);
 	if (searchForPeersRequired(query)) {
@@ -1728,6 +1730,34 @@ void Widget::searchMore() {
 	}
 }
 
+void Widget::searchLocalMessages() {
+	// Show already loaded messages until the server results arrive.
+	const auto peer = searchInPeer();
+	const auto topic = searchInTopic();
+	auto items = session().data().messagesTextIndex().search({
+		.query = _searchQuery,
+		.history = peer ? session().data().history(peer).get() : nullptr,
+		.topicRootId = topic ? topic->rootId() : MsgId(),
+		.from = _searchQueryFrom,
+		.limit = kSearchPerPage,
+	});
+	if (!peer && session().settings().skipArchiveInSearch()) {
+		items.erase(ranges::remove_if(items, [](not_null<HistoryItem*> item) {
+			return (item->history()->folder() != nullptr);
+		}), end(items));
+	}
+	if (items.empty()) {
+		return;
+	}
+	const auto type = peer
+		? SearchRequestType::PeerFromStart
+		: SearchRequestType::FromStart;
+	const auto count = int(items.size());
+	_inner->searchReceived(std::move(items), nullptr, type, count);
+	listScrollUpdated();
+	update();
+}
+
 void Widget::searchReceived(
 		SearchRequestType type,
 		const MTPmessages_Messages &result,
@@ -143,6 +143,7 @@ private:
 	void needSearchMessages();
 
 	void slideFinished();
+	void searchLocalMessages();
 	void searchReceived(
 		SearchRequestType type,
 		const MTPmessages_Messages &result,
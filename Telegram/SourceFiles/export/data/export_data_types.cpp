@@ -1831,6 +1831,10 @@ MessagesSlice AdjustMigrateMessageIds(MessagesSlice slice) {
 	return slice;
 }
 
+int32 UnadjustMigrateMessageId(int32 id) {
+	return id - kMigratedMessagesIdShift;
+}
+
 TimeId SingleMessageDate(const MTPmessages_Messages &data) {
 	return data.match([&](const MTPDmessages_messagesNotModified &data) {
 		return 0;
@@ -1847,6 +1851,20 @@ TimeId SingleMessageDate(const MTPmessages_Messages &data) {
 	});
 }
 
+int32 SingleMessageId(const MTPmessages_Messages &data) {
+	return data.match([&](const MTPDmessages_messagesNotModified &data) {
+		return 0;
+	}, [&](const auto &data) {
+		const auto &list = data.vmessages().v;
+		if (list.isEmpty()) {
+			return 0;
+		}
+		return list[0].match([](const auto &data) {
+			return data.vid().v;
+		});
+	});
+}
+
 bool SingleMessageBefore(
 		const MTPmessages_Messages &data,
 		TimeId date) {
@@ -710,6 +710,10 @@ struct DialogInfo {
 
 	// Filled when requesting dialog messages.
 	std::vector<int> messagesCountPerSplit;
+
+	// Filled from the export checkpoint, messages with ids up to this
+	// one are skipped. Ids of the migrated chat messages are adjusted.
+	int32 exportedTillId = 0;
 };
 
 struct DialogsInfo {
@@ -749,7 +753,9 @@ MessagesSlice ParseMessagesSlice(
 	const MTPVector<MTPChat> &chats,
 	const QString &mediaFolder);
 MessagesSlice AdjustMigrateMessageIds(MessagesSlice slice);
+int32 UnadjustMigrateMessageId(int32 id);
 
+int32 SingleMessageId(const MTPmessages_Messages &data);
 bool SingleMessageBefore(
 	const MTPmessages_Messages &data,
 	TimeId date);
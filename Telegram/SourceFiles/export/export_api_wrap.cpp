@@ -14,6 +14,10 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "mtproto/mtproto_response.h"
 #include "base/bytes.h"
 #include "base/random.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+
 #include <set>
 #include <deque>
 
@@ -22,7 +26,8 @@ namespace {
 
 constexpr auto kUserpicsSliceLimit = 100;
 constexpr auto kFileChunkSize = 128 * 1024;
-constexpr auto kFileRequestsCount = 2;
+constexpr auto kDefaultFileRequestsCount = 4;
+constexpr auto kMaxFileRequestsCount = 16;
 //constexpr auto kFileNextRequestDelay = crl::time(20);
 constexpr auto kChatsSliceLimit = 100;
 constexpr auto kMessagesSliceLimit = 100;
@@ -30,6 +35,7 @@ constexpr auto kTopPeerSliceLimit = 100;
 constexpr auto kFileMaxSize = 4000 * int64(1024 * 1024);
 constexpr auto kLocationCacheSize = 100'000;
 constexpr auto kMaxEmojiPerRequest = 100;
+constexpr auto kFilesIndexName = ".export_files";
 
 struct LocationKey {
 	uint64 type;
@@ -86,6 +92,17 @@ Settings::Type SettingsFromDialogsType(Data::DialogInfo::Type type) {
 	return Settings::Type(0);
 }
 
+// Messages are requested from this id, so the ones exported before are
+// skipped. Split indices below zero are of the migrated chat.
+int32 FirstMessageIdInSplit(const Data::DialogInfo &info, int splitIndex) {
+	const auto till = info.exportedTillId;
+	return (splitIndex >= 0)
+		? (std::max(till, 0) + 1)
+		: (till < 0)
+		? (Data::UnadjustMigrateMessageId(till) + 1)
+		: 1;
+}
+
 } // namespace
 
 class ApiWrap::LoadedFileCache {
@@ -104,6 +121,35 @@ private:
 
 };
 
+// Files downloaded by all exports to the same folder, persisted on disk
+// after each file, so that a restarted export copies them locally
+// instead of downloading them once again.
+class ApiWrap::FilesIndex {
+public:
+	using Location = Data::FileLocation;
+
+	explicit FilesIndex(const QString &folder);
+
+	void save(
+		const Location &location,
+		const QString &path,
+		int64 size);
+	[[nodiscard]] std::optional<QString> find(
+		const Location &location) const;
+
+private:
+	struct Entry {
+		QString path;
+		int64 size = 0;
+	};
+
+	void load();
+
+	QString _path;
+	std::map<LocationKey, Entry> _map;
+
+};
+
 struct ApiWrap::StartProcess {
 	FnMut<void(StartInfo)> done;
 
@@ -162,8 +208,11 @@ struct ApiWrap::FileProcess {
 	struct Request {
 		int64 offset = 0;
 		QByteArray bytes;
+		mtpRequestId requestId = 0;
 	};
 	std::deque<Request> requests;
+
+	// File reference refresh request, parts are not requested meanwhile.
 	mtpRequestId requestId = 0;
 };
 
@@ -211,6 +260,13 @@ struct ApiWrap::ChatProcess {
 	std::optional<Data::MessagesSlice> slice;
 	bool lastSlice = false;
 	int fileIndex = 0;
+
+	// The next slice of the same split is requested
+	// while the files of the current one are loading.
+	std::optional<Data::MessagesSlice> preloaded;
+	bool preloadedLast = false;
+	bool preloading = false;
+	bool waitingPreloaded = false;
 };
 
 
@@ -322,6 +378,81 @@ std::optional<QString> ApiWrap::LoadedFileCache::find(
 	return std::nullopt;
 }
 
+ApiWrap::FilesIndex::FilesIndex(const QString &folder)
+: _path(folder.isEmpty()
+	? QString()
+	: (QDir(folder).absolutePath() + '/' + kFilesIndexName)) {
+	load();
+}
+
+void ApiWrap::FilesIndex::load() {
+	if (_path.isEmpty()) {
+		return;
+	}
+	auto file = QFile(_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+
+	// Each line is "type id size path", later lines override earlier ones.
+	while (!file.atEnd()) {
+		const auto line = QString::fromUtf8(file.readLine()).trimmed();
+		const auto parts = line.split(' ');
+		if (parts.size() < 4) {
+			continue;
+		}
+		const auto key = LocationKey{
+			parts[0].toULongLong(),
+			parts[1].toULongLong(),
+		};
+		const auto size = parts[2].toLongLong();
+		const auto path = line.section(' ', 3);
+		if (key.id && size > 0 && !path.isEmpty()) {
+			_map[key] = Entry{ path, size };
+		}
+	}
+}
+
+void ApiWrap::FilesIndex::save(
+		const Location &location,
+		const QString &path,
+		int64 size) {
+	if (_path.isEmpty() || !location || size <= 0) {
+		return;
+	}
+	const auto key = ComputeLocationKey(location);
+	if (!key.id) {
+		return;
+	}
+	const auto absolute = QFileInfo(path).absoluteFilePath();
+	_map[key] = Entry{ absolute, size };
+
+	auto file = QFile(_path);
+	if (!file.open(QIODevice::Append)) {
+		return;
+	}
+	file.write(QString("%1 %2 %3 %4\n"
+	).arg(key.type
+	).arg(key.id
+	).arg(size
+	).arg(absolute).toUtf8());
+}
+
+std::optional<QString> ApiWrap::FilesIndex::find(
+		const Location &location) const {
+	if (!location) {
+		return std::nullopt;
+	}
+	const auto i = _map.find(ComputeLocationKey(location));
+	if (i == end(_map)) {
+		return std::nullopt;
+	}
+	const auto info = QFileInfo(i->second.path);
+	return (info.exists() && info.size() == i->second.size)
+		? std::make_optional(i->second.path)
+		: std::nullopt;
+}
+
 ApiWrap::FileProcess::FileProcess(const QString &path, Output::Stats *stats)
 : file(path, stats) {
 }
@@ -366,7 +497,7 @@ auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
 			MTP_long(offset),
 			MTP_int(kFileChunkSize))
 	)).fail([=](const MTP::Error &result) {
-		_fileProcess->requestId = 0;
+		filePartRequestFinished(offset);
 		if (result.type() == u"TAKEOUT_FILE_EMPTY"_q
 			&& _otherDataProcess != nullptr) {
 			filePartDone(
@@ -410,6 +541,10 @@ void ApiWrap::startExport(
 
 	_settings = std::make_unique<Settings>(settings);
 	_stats = stats;
+	_fileRequestsLimit = (_settings->fileRequestsLimit > 0)
+		? std::min(_settings->fileRequestsLimit, kMaxFileRequestsCount)
+		: kDefaultFileRequestsCount;
+	_filesIndex = std::make_unique<FilesIndex>(_settings->filesIndexFolder);
 	_startProcess = std::make_unique<StartProcess>();
 	_startProcess->done = std::move(done);
 
@@ -949,6 +1084,9 @@ void ApiWrap::requestMessages(
 	_chatProcess->fileProgress = std::move(progress);
 	_chatProcess->handleSlice = std::move(slice);
 	_chatProcess->done = std::move(done);
+	_chatProcess->largestIdPlusOne = FirstMessageIdInSplit(
+		info,
+		info.splits.front());
 
 	requestMessagesCount(0);
 }
@@ -957,8 +1095,14 @@ void ApiWrap::requestMessagesCount(int localSplitIndex) {
 	Expects(_chatProcess != nullptr);
 	Expects(localSplitIndex < _chatProcess->info.splits.size());
 
+	const auto splitIndex = _chatProcess->info.splits[localSplitIndex];
+	if (splitIndex < 0 && _chatProcess->info.exportedTillId > 0) {
+		// The migrated chat was exported before the current one.
+		messagesCountLoaded(localSplitIndex, 0);
+		return;
+	}
 	requestChatMessages(
-		_chatProcess->info.splits[localSplitIndex],
+		splitIndex,
 		0, // offset_id
 		0, // add_offset
 		1, // limit
@@ -979,11 +1123,16 @@ void ApiWrap::requestMessagesCount(int localSplitIndex) {
 			error("Unexpected messagesNotModified received.");
 			return;
 		}
+		const auto firstId = FirstMessageIdInSplit(
+			_chatProcess->info,
+			splitIndex);
 		const auto skipSplit = !Data::SingleMessageAfter(
 			result,
-			_settings->singlePeerFrom);
+			_settings->singlePeerFrom)
+			|| (Data::SingleMessageId(result) < firstId);
 		if (skipSplit) {
-			// No messages from the requested range, skip this split.
+			// No messages from the requested range
+			// or newer than the exported ones, skip this split.
 			messagesCountLoaded(localSplitIndex, 0);
 			return;
 		}
@@ -1042,8 +1191,7 @@ void ApiWrap::skipFile(uint64 randomId) {
 	}
 	LOG(("Export Info: File skipped."));
 	Assert(!_fileProcess->requests.empty());
-	Assert(_fileProcess->requestId != 0);
-	_mtp.request(base::take(_fileProcess->requestId)).cancel();
+	cancelFileRequests();
 	base::take(_fileProcess)->done(QString());
 }
 
@@ -1362,6 +1510,15 @@ void ApiWrap::appendChatsSlice(
 void ApiWrap::requestMessagesSlice() {
 	Expects(_chatProcess != nullptr);
 
+	if (_chatProcess->preloaded) {
+		_chatProcess->lastSlice = _chatProcess->preloadedLast;
+		loadMessagesFiles(*base::take(_chatProcess->preloaded));
+		return;
+	} else if (_chatProcess->preloading) {
+		_chatProcess->waitingPreloaded = true;
+		return;
+	}
+
 	const auto count = _chatProcess->info.messagesCountPerSplit[
 		_chatProcess->localSplitIndex];
 	if (!count) {
@@ -1392,6 +1549,39 @@ void ApiWrap::requestMessagesSlice() {
 	});
 }
 
+void ApiWrap::preloadMessagesSlice(int32 largestIdPlusOne) {
+	Expects(_chatProcess != nullptr);
+	Expects(!_chatProcess->preloading);
+	Expects(!_chatProcess->preloaded.has_value());
+
+	_chatProcess->preloading = true;
+	requestChatMessages(
+		_chatProcess->info.splits[_chatProcess->localSplitIndex],
+		largestIdPlusOne,
+		-kMessagesSliceLimit,
+		kMessagesSliceLimit,
+		[=](const MTPmessages_Messages &result) {
+		Expects(_chatProcess != nullptr);
+
+		_chatProcess->preloading = false;
+		result.match([&](const MTPDmessages_messagesNotModified &data) {
+			error("Unexpected messagesNotModified received.");
+		}, [&](const auto &data) {
+			_chatProcess->preloadedLast
+				= MTPDmessages_messages::Is<decltype(data)>();
+			_chatProcess->preloaded = Data::ParseMessagesSlice(
+				_chatProcess->context,
+				data.vmessages(),
+				data.vusers(),
+				data.vchats(),
+				_chatProcess->info.relativePath);
+			if (base::take(_chatProcess->waitingPreloaded)) {
+				requestMessagesSlice();
+			}
+		});
+	});
+}
+
 void ApiWrap::requestChatMessages(
 		int splitIndex,
 		int offsetId,
@@ -1472,6 +1662,8 @@ void ApiWrap::loadMessagesFiles(Data::MessagesSlice &&slice) {
 
 	if (slice.list.empty()) {
 		_chatProcess->lastSlice = true;
+	} else if (!_chatProcess->lastSlice) {
+		preloadMessagesSlice(slice.list.back().id + 1);
 	}
 	_chatProcess->slice = std::move(slice);
 	_chatProcess->fileIndex = 0;
@@ -1667,7 +1859,9 @@ void ApiWrap::finishMessagesSlice() {
 		&& (++_chatProcess->localSplitIndex
 			< _chatProcess->info.splits.size())) {
 		_chatProcess->lastSlice = false;
-		_chatProcess->largestIdPlusOne = 1;
+		_chatProcess->largestIdPlusOne = FirstMessageIdInSplit(
+			_chatProcess->info,
+			_chatProcess->info.splits[_chatProcess->localSplitIndex]);
 	}
 	if (!_chatProcess->lastSlice) {
 		requestMessagesSlice();
@@ -1743,6 +1937,7 @@ void ApiWrap::loadMessageEmojiDone(uint64 id, const QString &relativePath) {
 void ApiWrap::finishMessages() {
 	Expects(_chatProcess != nullptr);
 	Expects(!_chatProcess->slice.has_value());
+	Expects(!_chatProcess->preloading);
 
 	const auto process = base::take(_chatProcess);
 	process->done();
@@ -1797,6 +1992,8 @@ bool ApiWrap::processFileLoad(
 		// Don't load thumbs for large files that we skip.
 		file.skipReason = SkipReason::FileSize;
 		return true;
+	} else if (copyIndexedFile(file)) {
+		return true;
 	}
 	loadFile(file, origin, std::move(progress), std::move(done));
 	return false;
@@ -1814,7 +2011,11 @@ bool ApiWrap::writePreloadedFile(
 		return true;
 	} else if (!file.content.isEmpty()) {
 		const auto process = prepareFileProcess(file, origin);
-		if (const auto result = process->file.writeBlock(file.content)) {
+		auto result = process->file.writeBlock(file.content);
+		if (result) {
+			result = process->file.flush();
+		}
+		if (result) {
 			file.relativePath = process->relativePath;
 			_fileCache->save(file.location, file.relativePath);
 		} else {
@@ -1825,6 +2026,32 @@ bool ApiWrap::writePreloadedFile(
 	return false;
 }
 
+bool ApiWrap::copyIndexedFile(Data::File &file) {
+	Expects(_settings != nullptr);
+
+	using namespace Output;
+
+	const auto source = _filesIndex->find(file.location);
+	if (!source) {
+		return false;
+	}
+	const auto relativePath = File::PrepareRelativePath(
+		_settings->path,
+		file.suggestedPath);
+	const auto result = File::Copy(
+		*source,
+		_settings->path + relativePath,
+		_stats);
+	if (!result) {
+		LOG(("Export Error: Could not copy '%1', downloading it again."
+			).arg(*source));
+		return false;
+	}
+	file.relativePath = relativePath;
+	_fileCache->save(file.location, relativePath);
+	return true;
+}
+
 void ApiWrap::loadFile(
 		const Data::File &file,
 		const Data::FileOrigin &origin,
@@ -1850,7 +2077,7 @@ void ApiWrap::loadFile(
 
 	loadFilePart();
 
-	Ensures(_fileProcess->requestId != 0);
+	Ensures(!_fileProcess->requests.empty());
 }
 
 auto ApiWrap::prepareFileProcess(
@@ -1874,36 +2101,67 @@ auto ApiWrap::prepareFileProcess(
 }
 
 void ApiWrap::loadFilePart() {
-	if (!_fileProcess
-		|| _fileProcess->requestId
-		|| _fileProcess->requests.size() >= kFileRequestsCount
-		|| (_fileProcess->size > 0
-			&& _fileProcess->offset >= _fileProcess->size)) {
+	if (!_fileProcess || _fileProcess->requestId) {
 		return;
 	}
 
-	const auto offset = _fileProcess->offset;
-	_fileProcess->requests.push_back({ offset });
-	_fileProcess->requestId = fileRequest(
+	// Without a known size we request parts one by one till an empty one.
+	const auto size = _fileProcess->size;
+	const auto limit = (size > 0) ? _fileRequestsLimit : 1;
+	auto &requests = _fileProcess->requests;
+	while (int(requests.size()) < limit
+		&& (size <= 0 || _fileProcess->offset < size)) {
+		const auto offset = _fileProcess->offset;
+		requests.push_back({ offset });
+		requests.back().requestId = sendFilePartRequest(offset);
+		_fileProcess->offset += kFileChunkSize;
+	}
+}
+
+mtpRequestId ApiWrap::sendFilePartRequest(int64 offset) {
+	Expects(_fileProcess != nullptr);
+
+	return fileRequest(
 		_fileProcess->location,
-		_fileProcess->offset
+		offset
 	).done([=](const MTPupload_File &result) {
-		_fileProcess->requestId = 0;
+		filePartRequestFinished(offset);
 		filePartDone(offset, result);
 	}).send();
-	_fileProcess->offset += kFileChunkSize;
+}
+
+void ApiWrap::filePartRequestFinished(int64 offset) {
+	Expects(_fileProcess != nullptr);
+
+	using Request = FileProcess::Request;
+	auto &requests = _fileProcess->requests;
+	const auto i = ranges::find(requests, offset, &Request::offset);
+	Assert(i != end(requests));
+
+	i->requestId = 0;
+}
+
+void ApiWrap::resendFileParts() {
+	Expects(_fileProcess != nullptr);
+	Expects(_fileProcess->requestId == 0);
+
+	for (auto &request : _fileProcess->requests) {
+		if (!request.requestId && request.bytes.isEmpty()) {
+			request.requestId = sendFilePartRequest(request.offset);
+		}
+	}
+}
+
+void ApiWrap::cancelFileRequests() {
+	Expects(_fileProcess != nullptr);
 
-	if (_fileProcess->size > 0
-		&& _fileProcess->requests.size() < kFileRequestsCount) {
-		// Only one request at a time supported right now.
-		//const auto runner = _runner;
-		//crl::on_main([=] {
-		//	QTimer::singleShot(kFileNextRequestDelay, [=] {
-		//		runner([=] {
-		//			loadFilePart();
-		//		});
-		//	});
-		//});
+	for (auto &request : _fileProcess->requests) {
+		if (const auto requestId = base::take(request.requestId)) {
+			_mtp.request(requestId).cancel();
+		}
+	}
+	if (const auto requestId = base::take(_fileProcess->requestId)) {
+		_mtp.request(requestId).cancel();
 	}
 }
 
@@ -1961,15 +2219,34 @@ void ApiWrap::filePartDone(int64 offset, const MTPupload_File &result) {
 		}
 	}
 
+	if (const auto result = _fileProcess->file.flush(); !result) {
+		ioError(result);
+		return;
+	}
 	auto process = base::take(_fileProcess);
 	const auto relativePath = process->relativePath;
 	_fileCache->save(process->location, relativePath);
+	_filesIndex->save(
+		process->location,
+		_settings->path + relativePath,
+		process->file.size());
 	process->done(process->relativePath);
 }
 
 void ApiWrap::filePartRefreshReference(int64 offset) {
 	Expects(_fileProcess != nullptr);
-	Expects(_fileProcess->requestId == 0);
+
+	if (_fileProcess->requestId) {
+		// Already refreshing, the part will be requested again after that.
+		return;
+	}
+
+	// Other parts will fail with the same error, request them later.
+	for (auto &request : _fileProcess->requests) {
+		if (const auto requestId = base::take(request.requestId)) {
+			_mtp.request(requestId).cancel();
+		}
+	}
 
 	const auto &origin = _fileProcess->origin;
 	if (!origin.messageId) {
@@ -2046,13 +2323,7 @@ void ApiWrap::filePartExtractReference(
 					_fileProcess->location,
 					message.thumb().file.location);
 				if (refresh1 || refresh2) {
-					_fileProcess->requestId = fileRequest(
-						_fileProcess->location,
-						offset
-					).done([=](const MTPupload_File &result) {
-						_fileProcess->requestId = 0;
-						filePartDone(offset, result);
-					}).send();
+					resendFileParts();
 					return;
 				}
 			}
@@ -2067,6 +2338,7 @@ void ApiWrap::filePartUnavailable() {
 
 	LOG(("Export Error: File unavailable."));
 
+	cancelFileRequests();
 	base::take(_fileProcess)->done(QString());
 }
 
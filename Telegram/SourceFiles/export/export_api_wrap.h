@@ -93,6 +93,7 @@ public:
 
 private:
 	class LoadedFileCache;
+	class FilesIndex;
 	struct StartProcess;
 	struct ContactsProcess;
 	struct UserpicsProcess;
@@ -151,6 +152,7 @@ private:
 	void checkFirstMessageDate(int localSplitIndex, int count);
 	void messagesCountLoaded(int localSplitIndex, int count);
 	void requestMessagesSlice();
+	void preloadMessagesSlice(int32 largestIdPlusOne);
 	void requestChatMessages(
 		int splitIndex,
 		int offsetId,
@@ -186,12 +188,20 @@ private:
 	bool writePreloadedFile(
 		Data::File &file,
 		const Data::FileOrigin &origin);
+
+	// Copies a file downloaded by a previous export to the same folder,
+	// only for files that passed the export settings checks.
+	bool copyIndexedFile(Data::File &file);
 	void loadFile(
 		const Data::File &file,
 		const Data::FileOrigin &origin,
 		Fn<bool(FileProgress)> progress,
 		FnMut<void(QString)> done);
 	void loadFilePart();
+	mtpRequestId sendFilePartRequest(int64 offset);
+	void filePartRequestFinished(int64 offset);
+	void resendFileParts();
+	void cancelFileRequests();
 	void filePartDone(int64 offset, const MTPupload_File &result);
 	void filePartUnavailable();
 	void filePartRefreshReference(int64 offset);
@@ -226,6 +236,7 @@ private:
 
 	std::unique_ptr<StartProcess> _startProcess;
 	std::unique_ptr<LoadedFileCache> _fileCache;
+	std::unique_ptr<FilesIndex> _filesIndex;
 	std::unique_ptr<ContactsProcess> _contactsProcess;
 	std::unique_ptr<UserpicsProcess> _userpicsProcess;
 	std::unique_ptr<OtherDataProcess> _otherDataProcess;
@@ -236,6 +247,7 @@ private:
 	base::flat_set<uint64> _unresolvedCustomEmoji;
 	base::flat_map<uint64, Data::Document> _resolvedCustomEmoji;
 	QVector<MTPMessageRange> _splits;
+	int _fileRequestsLimit = 0;
 
 	rpl::event_stream<MTP::Error> _errors;
 	rpl::event_stream<Output::Result> _ioErrors;
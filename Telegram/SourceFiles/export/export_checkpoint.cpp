@@ -0,0 +1,167 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "export/export_checkpoint.h"
+
+#include "export/export_settings.h"
+
+#include <QtCore/QSaveFile>
+
+namespace Export {
+namespace {
+
+constexpr auto kCheckpointName = ".export_progress";
+
+// Identifies the chats an export goes through,
+// only an export of the same chats is resumed.
+[[nodiscard]] QString RunTag(const Settings &settings) {
+	const auto peer = settings.singlePeer.match([](
+			const MTPDinputPeerEmpty &) {
+		return u"all"_q;
+	}, [](const MTPDinputPeerSelf &) {
+		return u"self"_q;
+	}, [](const MTPDinputPeerUser &data) {
+		return u"user%1"_q.arg(data.vuser_id().v);
+	}, [](const MTPDinputPeerChat &data) {
+		return u"chat%1"_q.arg(data.vchat_id().v);
+	}, [](const MTPDinputPeerChannel &data) {
+		return u"channel%1"_q.arg(data.vchannel_id().v);
+	}, [](const auto &) {
+		return u"other"_q;
+	});
+	return u"%1-%2-%3-%4-%5"_q
+		.arg(peer)
+		.arg(quint32(settings.types))
+		.arg(quint32(settings.fullChats))
+		.arg(settings.singlePeerFrom)
+		.arg(settings.singlePeerTill);
+}
+
+} // namespace
+
+Checkpoint::Checkpoint(const Settings &settings)
+: _path(settings.filesIndexFolder.isEmpty()
+	? QString()
+	: (QDir(settings.filesIndexFolder).absolutePath()
+		+ '/'
+		+ kCheckpointName))
+, _incremental(settings.incremental) {
+	if (!_path.isEmpty()) {
+		load(RunTag(settings));
+	}
+}
+
+void Checkpoint::load(const QString &tag) {
+	auto lastTag = QString();
+	auto completed = false;
+	auto file = QFile(_path);
+	if (file.open(QIODevice::ReadOnly)) {
+		// Each line is "run tag", "peer id", "peer finished" or "complete".
+		while (!file.atEnd()) {
+			const auto line = QString::fromUtf8(file.readLine()).trimmed();
+			const auto parts = line.split(' ');
+			if (line == u"complete"_q) {
+				completed = true;
+			} else if (parts.size() != 2) {
+				continue;
+			} else if (parts[0] == u"run"_q) {
+				lastTag = parts[1];
+				completed = false;
+				_progress.clear();
+				_finished.clear();
+			} else if (const auto peerId = PeerId(parts[0].toULongLong())) {
+				if (parts[1] == u"finished"_q) {
+					_finished.emplace(peerId);
+				} else if (const auto id = parts[1].toInt()) {
+					remember(peerId, id);
+				}
+			}
+		}
+		file.close();
+	}
+	if (completed || lastTag != tag) {
+		startRun(tag);
+	} else {
+		LOG(("Export Info: Resuming, %1 chats finished before."
+			).arg(_finished.size()));
+	}
+}
+
+void Checkpoint::startRun(const QString &tag) {
+	_progress.clear();
+	_finished.clear();
+
+	// Drop the finished runs, keeping only the last exported ids.
+	auto file = QSaveFile(_path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		LOG(("Export Error: Could not write '%1'.").arg(_path));
+		_path = QString();
+		return;
+	}
+	auto data = QByteArray();
+	for (const auto &[peerId, id] : _exported) {
+		data.append(QString("%1 %2\n").arg(peerId.value).arg(id).toUtf8());
+	}
+	data.append(QString("run %1\n").arg(tag).toUtf8());
+	if (file.write(data) != data.size() || !file.commit()) {
+		LOG(("Export Error: Could not write '%1'.").arg(_path));
+		_path = QString();
+	}
+}
+
+int32 Checkpoint::exportedTillId(PeerId peerId) const {
+	const auto &map = _incremental ? _exported : _progress;
+	const auto i = map.find(peerId);
+	return (i != end(map)) ? i->second : 0;
+}
+
+bool Checkpoint::finished(PeerId peerId) const {
+	return _finished.contains(peerId);
+}
+
+void Checkpoint::exported(PeerId peerId, int32 messageId) {
+	if (_path.isEmpty() || !peerId || !messageId) {
+		return;
+	}
+	remember(peerId, messageId);
+	append(QString("%1 %2").arg(peerId.value).arg(messageId));
+}
+
+void Checkpoint::finish(PeerId peerId) {
+	if (_path.isEmpty() || !peerId) {
+		return;
+	}
+	_finished.emplace(peerId);
+	append(QString("%1 finished").arg(peerId.value));
+}
+
+void Checkpoint::complete() {
+	if (_path.isEmpty()) {
+		return;
+	}
+	append(u"complete"_q);
+}
+
+void Checkpoint::remember(PeerId peerId, int32 messageId) {
+	// Migrated chat messages have negative ids and are exported first.
+	const auto i = _exported.find(peerId);
+	if (i == end(_exported)) {
+		_exported.emplace(peerId, messageId);
+	} else {
+		i->second = std::max(i->second, messageId);
+	}
+	_progress[peerId] = messageId;
+}
+
+void Checkpoint::append(const QString &line) {
+	auto file = QFile(_path);
+	if (file.open(QIODevice::Append)) {
+		file.write((line + '\n').toUtf8());
+	}
+}
+
+} // namespace Export
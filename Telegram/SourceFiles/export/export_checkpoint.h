@@ -0,0 +1,51 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#pragma once
+
+#include "data/data_peer_id.h"
+
+namespace Export {
+
+struct Settings;
+
+// Export progress of each dialog, persisted next to the files index
+// in the folder chosen by the user. An interrupted export into the same
+// folder with the same chats skips the dialogs it has finished and goes on
+// after the last message it has written. In the incremental mode only the
+// messages newer than ones exported before to that folder are written.
+class Checkpoint final {
+public:
+	explicit Checkpoint(const Settings &settings);
+
+	// Messages with ids up to this one are not exported again.
+	[[nodiscard]] int32 exportedTillId(PeerId peerId) const;
+	[[nodiscard]] bool finished(PeerId peerId) const;
+
+	void exported(PeerId peerId, int32 messageId);
+	void finish(PeerId peerId);
+	void complete();
+
+private:
+	void load(const QString &tag);
+	void startRun(const QString &tag);
+	void remember(PeerId peerId, int32 messageId);
+	void append(const QString &line);
+
+	QString _path;
+	bool _incremental = false;
+
+	// Last message ids written by all the exports to the folder.
+	base::flat_map<PeerId, int32> _exported;
+
+	// Progress of the current export, kept if it was interrupted.
+	base::flat_map<PeerId, int32> _progress;
+	base::flat_set<PeerId> _finished;
+
+};
+
+} // namespace Export
@@ -8,12 +8,14 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "export/export_controller.h"
 
 #include "export/export_api_wrap.h"
+#include "export/export_checkpoint.h"
 #include "export/export_settings.h"
 #include "export/data/export_data_types.h"
 #include "export/output/export_output_abstract.h"
 #include "export/output/export_output_result.h"
 #include "export/output/export_output_stats.h"
 #include "mtproto/mtp_instance.h"
+#include "extera/extera_settings.h"
 
 namespace Export {
 namespace {
@@ -73,6 +75,7 @@ private:
 	void initialize();
 	void initialized(const ApiWrap::StartInfo &info);
 	void collectDialogsList();
+	void skipExportedDialogs();
 	void exportPersonalInfo();
 	void exportUserpics();
 	void exportContacts();
@@ -107,6 +110,7 @@ private:
 
 	Data::DialogsInfo _dialogsInfo;
 	int _dialogIndex = -1;
+	std::unique_ptr<Checkpoint> _checkpoint;
 
 	int _messagesWritten = 0;
 	int _messagesCount = 0;
@@ -248,7 +252,9 @@ void ControllerObject::startExport(
 	_settings = NormalizeSettings(settings);
 	_environment = environment;
 
+	_settings.filesIndexFolder = _settings.path;
 	_settings.path = Output::NormalizePath(_settings);
+	_checkpoint = std::make_unique<Checkpoint>(_settings);
 	_writer = Output::CreateWriter(_settings.format);
 	fillExportSteps();
 	exportNext();
@@ -332,6 +338,7 @@ void ControllerObject::exportNext() {
 		if (ioCatchError(_writer->finish())) {
 			return;
 		}
+		_checkpoint->complete();
 		_api.finishExport([=] {
 			setFinishedState();
 		});
@@ -376,10 +383,35 @@ void ControllerObject::collectDialogsList() {
 		return true;
 	}, [=](Data::DialogsInfo &&result) {
 		_dialogsInfo = std::move(result);
+		skipExportedDialogs();
 		exportNext();
 	});
 }
 
+void ControllerObject::skipExportedDialogs() {
+	const auto skip = [&](const Data::DialogInfo &info) {
+		if (_checkpoint->finished(info.peerId)) {
+			return true;
+		} else if (!_settings.incremental) {
+			return false;
+		}
+		const auto till = _checkpoint->exportedTillId(info.peerId);
+		return (till > 0)
+			&& (info.topMessageId > 0)
+			&& (info.topMessageId <= till);
+	};
+	auto skipped = 0;
+	for (const auto list : { &_dialogsInfo.chats, &_dialogsInfo.left }) {
+		const auto from = ranges::remove_if(*list, skip);
+		skipped += int(end(*list) - from);
+		list->erase(from, end(*list));
+	}
+	if (skipped > 0) {
+		LOG(("Export Info: Skipped %1 chats exported before."
+			).arg(skipped));
+	}
+}
+
 void ControllerObject::exportPersonalInfo() {
 	setState(statePersonalInfo());
 	_api.requestPersonalInfo([=](Data::PersonalInfo &&result) {
@@ -459,6 +491,8 @@ void ControllerObject::exportNextDialog() {
 	const auto index = ++_dialogIndex;
 	const auto info = _dialogsInfo.item(index);
 	if (info) {
+		const auto peerId = info->peerId;
+		info->exportedTillId = _checkpoint->exportedTillId(peerId);
 		_api.requestMessages(*info, [=](const Data::DialogInfo &info) {
 			if (ioCatchError(_writer->writeDialogStart(info))) {
 				return false;
@@ -476,6 +510,7 @@ void ControllerObject::exportNextDialog() {
 			if (ioCatchError(_writer->writeDialogSlice(result))) {
 				return false;
 			}
+			_checkpoint->exported(peerId, result.list.back().id);
 			_messagesWritten += result.list.size();
 			setState(stateDialogs(DownloadProgress()));
 			return true;
@@ -483,6 +518,7 @@ void ControllerObject::exportNextDialog() {
 			if (ioCatchError(_writer->writeDialogEnd())) {
 				return;
 			}
+			_checkpoint->finish(peerId);
 			exportNextDialog();
 		});
 		return;
@@ -656,8 +692,11 @@ void Controller::startExport(
 		const Environment &environment) {
 	LOG(("Export Info: Started export to '%1'.").arg(settings.path));
 
+	auto copy = settings;
+	copy.fileRequestsLimit = ::ExteraSettings::JsonSettings::GetInt(
+		"export_file_requests");
 	_wrapped.with([=](Implementation &unwrapped) {
-		unwrapped.startExport(settings, environment);
+		unwrapped.startExport(copy, environment);
 	});
 }
 
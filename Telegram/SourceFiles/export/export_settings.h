@@ -83,6 +83,18 @@ struct Settings {
 
 	TimeId availableAt = 0;
 
+	// Export only the messages newer than the ones exported before
+	// to the same folder.
+	bool incremental = false;
+
+	// Taken from the client settings when the export starts, not saved.
+	int fileRequestsLimit = 0;
+
+	// The folder chosen by the user, before a subfolder is added to it.
+	// Keeps the files index and the checkpoint of all exports to it.
+	// Not saved, filled when the export starts.
+	QString filesIndexFolder;
+
 	bool onlySinglePeer() const {
 		return singlePeer.type() != mtpc_inputPeerEmpty;
 	}
@@ -50,6 +50,9 @@ std::unique_ptr<AbstractWriter> CreateWriter(Format format) {
 	switch (format) {
 	case Format::Html: return std::make_unique<HtmlWriter>();
 	case Format::Json: return std::make_unique<JsonWriter>();
+	case Format::JsonLines: return std::make_unique<JsonLinesWriter>();
+	case Format::JsonLinesGzip:
+		return std::make_unique<JsonLinesWriter>(true);
 	}
 	Unexpected("Format in Export::Output::CreateWriter.");
 }
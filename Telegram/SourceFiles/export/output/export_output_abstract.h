@@ -35,6 +35,8 @@ class Stats;
 enum class Format {
 	Html,
 	Json,
+	JsonLines,
+	JsonLinesGzip,
 };
 
 class AbstractWriter {
@@ -18,39 +18,73 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 
 namespace Export {
 namespace Output {
+namespace {
+
+constexpr auto kBufferSize = 256 * 1024;
+constexpr auto kCopyChunkSize = 1024 * 1024;
+
+} // namespace
 
 File::File(const QString &path, Stats *stats) : _path(path), _stats(stats) {
 }
 
+File::~File() {
+	if (!_buffer.isEmpty() && !flush()) {
+		LOG(("Export Error: Could not write buffered data to '%1'."
+			).arg(_path));
+	}
+}
+
 int64 File::size() const {
-	return _offset;
+	return _offset + _buffer.size();
 }
 
 bool File::empty() const {
-	return !_offset;
+	return !size();
 }
 
 Result File::writeBlock(const QByteArray &block) {
-	const auto result = writeBlockAttempt(block);
+	if (_stats && !_inStats) {
+		_inStats = true;
+		_stats->incrementFiles();
+	}
+	if (block.isEmpty()) {
+		// Make sure the file exists even if nothing is written to it.
+		return flush();
+	} else if (_buffer.isEmpty() && block.size() >= kBufferSize) {
+		return writeData(block);
+	}
+	_buffer.append(block);
+	return (_buffer.size() >= kBufferSize) ? flush() : Result::Success();
+}
+
+Result File::flush() {
+	const auto result = writeData(_buffer);
+	if (result) {
+		_buffer.clear();
+	}
+	return result;
+}
+
+Result File::writeData(const QByteArray &data) {
+	const auto result = writeDataAttempt(data);
 	if (!result) {
+		// The buffer is kept, so the next attempt will truncate the file
+		// to the written offset and write the buffered data once again.
 		_file.reset();
 	}
 	return result;
 }
 
-Result File::writeBlockAttempt(const QByteArray &block) {
-	if (_stats && !_inStats) {
-		_inStats = true;
-		_stats->incrementFiles();
-	}
+Result File::writeDataAttempt(const QByteArray &data) {
 	if (const auto result = reopen(); !result) {
 		return result;
 	}
-	const auto size = block.size();
+	const auto size = data.size();
 	if (!size) {
 		return Result::Success();
 	}
-	if (_file->write(block) == size && _file->flush()) {
+	if (_file->write(data) == size && _file->flush()) {
 		_offset += size;
 		if (_stats) {
 			_stats->incrementBytes(size);
@@ -129,11 +163,20 @@ Result File::Copy(
 	if (!f.exists() || !f.open(QIODevice::ReadOnly)) {
 		return Result(Result::Type::FatalError, source);
 	}
-	const auto bytes = f.readAll();
-	if (bytes.size() != f.size()) {
-		return Result(Result::Type::FatalError, source);
+	const auto size = f.size();
+	auto file = File(path, stats);
+	if (!size) {
+		return file.writeBlock({});
+	}
+	while (file.size() < size) {
+		const auto bytes = f.read(kCopyChunkSize);
+		if (bytes.isEmpty()) {
+			return Result(Result::Type::FatalError, source);
+		} else if (const auto result = file.writeBlock(bytes); !result) {
+			return result;
+		}
 	}
-	return File(path, stats).writeBlock(bytes);
+	return file.flush();
 }
 
 } // namespace Output
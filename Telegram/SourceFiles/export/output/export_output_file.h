@@ -19,14 +19,20 @@ namespace Output {
 struct Result;
 class Stats;
 
+// Small blocks are collected in memory and written to the file together.
+// Call flush() when the file is complete, to get the write result.
 class File {
 public:
 	File(const QString &path, Stats *stats);
+	File(const File &other) = delete;
+	File &operator=(const File &other) = delete;
+	~File();
 
 	[[nodiscard]] int64 size() const;
 	[[nodiscard]] bool empty() const;
 
 	[[nodiscard]] Result writeBlock(const QByteArray &block);
+	[[nodiscard]] Result flush();
 
 	[[nodiscard]] static QString PrepareRelativePath(
 		const QString &folder,
@@ -39,13 +45,15 @@ public:
 
 private:
 	[[nodiscard]] Result reopen();
-	[[nodiscard]] Result writeBlockAttempt(const QByteArray &block);
+	[[nodiscard]] Result writeData(const QByteArray &data);
+	[[nodiscard]] Result writeDataAttempt(const QByteArray &data);
 
 	[[nodiscard]] Result error() const;
 	[[nodiscard]] Result fatalError() const;
 
 	QString _path;
-	int64 _offset = 0;
+	int64 _offset = 0; // Already written to the file.
+	QByteArray _buffer;
 	std::optional<QFile> _file;
 
 	Stats *_stats = nullptr;
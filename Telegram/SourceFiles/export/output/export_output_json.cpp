@@ -17,10 +17,14 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonValue>
 
+#include <zlib.h>
+
 namespace Export {
 namespace Output {
 namespace {
 
+constexpr auto kCompressChunkSize = 64 * 1024;
+
 using Context = details::JsonContext;
 
 QByteArray SerializeString(const QByteArray &value) {
@@ -97,11 +101,18 @@ QByteArray Indentation(const Context &context) {
 QByteArray SerializeObject(
 		Context &context,
 		const std::vector<std::pair<QByteArray, QByteArray>> &values) {
-	const auto indent = Indentation(context);
+	const auto indent = context.compact
+		? QByteArray()
+		: '\n' + Indentation(context);
 
 	context.nesting.push_back(Context::kObject);
 	const auto guard = gsl::finally([&] { context.nesting.pop_back(); });
-	const auto next = '\n' + Indentation(context);
+	const auto next = context.compact
+		? QByteArray()
+		: '\n' + Indentation(context);
+	const auto separator = context.compact
+		? QByteArray(":")
+		: QByteArray(": ");
 
 	auto first = true;
 	auto result = QByteArray();
@@ -115,18 +126,22 @@ QByteArray SerializeObject(
 		} else {
 			result.append(',');
 		}
-		result.append(next).append(SerializeString(key)).append(": ", 2);
+		result.append(next).append(SerializeString(key)).append(separator);
 		result.append(value);
 	}
-	result.append('\n').append(indent).append("}");
+	result.append(indent).append("}");
 	return result;
 }
 
 QByteArray SerializeArray(
 		Context &context,
 		const std::vector<QByteArray> &values) {
-	const auto indent = Indentation(context.nesting.size());
-	const auto next = '\n' + Indentation(context.nesting.size() + 1);
+	const auto indent = context.compact
+		? QByteArray()
+		: '\n' + Indentation(context.nesting.size());
+	const auto next = context.compact
+		? QByteArray()
+		: '\n' + Indentation(context.nesting.size() + 1);
 
 	auto first = true;
 	auto result = QByteArray();
@@ -139,7 +154,7 @@ QByteArray SerializeArray(
 		}
 		result.append(next).append(value);
 	}
-	result.append('\n').append(indent).append("]");
+	result.append(indent).append("]");
 	return result;
 }
 
@@ -1146,6 +1161,13 @@ Result JsonWriter::writeDialogStart(const Data::DialogInfo &data) {
 		}
 	}
 
+	auto block = prepareDialogStart(data);
+	block.append(prepareObjectItemStart("messages"));
+	block.append(pushNesting(Context::kArray));
+	return _output->writeBlock(block);
+}
+
+QByteArray JsonWriter::prepareDialogStart(const Data::DialogInfo &data) {
 	using Type = Data::DialogInfo::Type;
 	const auto TypeString = [](Type type) {
 		switch (type) {
@@ -1175,9 +1197,7 @@ Result JsonWriter::writeDialogStart(const Data::DialogInfo &data) {
 		+ StringAllowNull(TypeString(data.type)));
 	block.append(prepareObjectItemStart("id")
 		+ Data::NumberToString(Data::PeerToBareId(data.peerId)));
-	block.append(prepareObjectItemStart("messages"));
-	block.append(pushNesting(Context::kArray));
-	return _output->writeBlock(block);
+	return block;
 }
 
 Result JsonWriter::validateDialogsMode(bool isLeftChannel) {
@@ -1255,11 +1275,14 @@ Result JsonWriter::finish() {
 
 	if (_settings.onlySinglePeer()) {
 		Assert(_context.nesting.empty());
-		return Result::Success();
+		return _output->flush();
 	}
 	auto block = popNesting();
 	Assert(_context.nesting.empty());
-	return _output->writeBlock(block);
+	if (const auto result = _output->writeBlock(block); !result) {
+		return result;
+	}
+	return _output->flush();
 }
 
 QString JsonWriter::mainFilePath() {
@@ -1279,5 +1302,166 @@ std::unique_ptr<File> JsonWriter::fileWithRelativePath(
 	return std::make_unique<File>(pathWithRelativePath(path), _stats);
 }
 
+// Keeps one gzip stream for the messages file of the current chat.
+class JsonLinesWriter::Compressor final {
+public:
+	Compressor() = default;
+	Compressor(const Compressor &other) = delete;
+	Compressor &operator=(const Compressor &other) = delete;
+	~Compressor();
+
+	[[nodiscard]] bool start();
+	[[nodiscard]] std::optional<QByteArray> compress(
+		const QByteArray &block,
+		bool last);
+
+private:
+	void finish();
+
+	z_stream _stream = z_stream();
+	bool _started = false;
+
+};
+
+JsonLinesWriter::Compressor::~Compressor() {
+	finish();
+}
+
+bool JsonLinesWriter::Compressor::start() {
+	finish();
+	_stream = z_stream();
+	_started = (deflateInit2(
+		&_stream,
+		Z_DEFAULT_COMPRESSION,
+		Z_DEFLATED,
+		16 + MAX_WBITS, // gzip header
+		8,
+		Z_DEFAULT_STRATEGY) == Z_OK);
+	return _started;
+}
+
+void JsonLinesWriter::Compressor::finish() {
+	if (base::take(_started)) {
+		deflateEnd(&_stream);
+	}
+}
+
+std::optional<QByteArray> JsonLinesWriter::Compressor::compress(
+		const QByteArray &block,
+		bool last) {
+	Expects(_started);
+
+	const auto flush = last ? Z_FINISH : Z_NO_FLUSH;
+	auto result = QByteArray();
+	auto chunk = QByteArray(
+		std::max(
+			int(deflateBound(&_stream, uLong(block.size()))),
+			kCompressChunkSize),
+		Qt::Uninitialized);
+	_stream.avail_in = uInt(block.size());
+	_stream.next_in = reinterpret_cast<Bytef*>(
+		const_cast<char*>(block.constData()));
+	while (true) {
+		_stream.avail_out = uInt(chunk.size());
+		_stream.next_out = reinterpret_cast<Bytef*>(chunk.data());
+		const auto res = deflate(&_stream, flush);
+		if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR) {
+			finish();
+			return std::nullopt;
+		}
+		result.append(chunk.constData(), chunk.size() - _stream.avail_out);
+		if (res == Z_STREAM_END) {
+			finish();
+			break;
+		} else if (!last && _stream.avail_out) {
+			// All the input is consumed, the rest stays buffered.
+			break;
+		}
+	}
+	return result;
+}
+
+JsonLinesWriter::JsonLinesWriter(bool compressed)
+: _compressor(compressed ? std::make_unique<Compressor>() : nullptr) {
+}
+
+JsonLinesWriter::~JsonLinesWriter() = default;
+
+Result JsonLinesWriter::writeMessagesBlock(
+		const QByteArray &block,
+		bool last) {
+	Expects(_messages != nullptr);
+
+	if (!_compressor) {
+		return block.isEmpty()
+			? Result::Success()
+			: _messages->writeBlock(block);
+	}
+	const auto compressed = _compressor->compress(block, last);
+	if (!compressed) {
+		LOG(("Export Error: Could not compress messages."));
+		return Result(Result::Type::FatalError, QString());
+	}
+	return compressed->isEmpty()
+		? Result::Success()
+		: _messages->writeBlock(*compressed);
+}
+
+Result JsonLinesWriter::writeDialogStart(const Data::DialogInfo &data) {
+	Expects(_output != nullptr);
+	Expects(_messages == nullptr);
+
+	if (!_settings.onlySinglePeer()) {
+		const auto result = validateDialogsMode(data.isLeftChannel);
+		if (!result) {
+			return result;
+		}
+	}
+
+	const auto messagesPath = data.relativePath
+		+ (_compressor ? "messages.jsonl.gz" : "messages.jsonl");
+	auto block = prepareDialogStart(data);
+	block.append(prepareObjectItemStart("messages_file")
+		+ SerializeString(messagesPath.toUtf8()));
+	block.append(popNesting());
+	if (const auto result = _output->writeBlock(block); !result) {
+		return result;
+	}
+	if (_compressor && !_compressor->start()) {
+		LOG(("Export Error: Could not start compression."));
+		return Result(Result::Type::FatalError, messagesPath);
+	}
+	_messages = fileWithRelativePath(messagesPath);
+	return Result::Success();
+}
+
+Result JsonLinesWriter::writeDialogSlice(const Data::MessagesSlice &data) {
+	Expects(_messages != nullptr);
+
+	auto block = QByteArray();
+	for (const auto &message : data.list) {
+		if (Data::SkipMessageByDate(message, _settings)) {
+			continue;
+		}
+		block.append(SerializeMessage(
+			_lineContext,
+			message,
+			data.peers,
+			_environment.internalLinksDomain));
+		block.append('\n');
+	}
+	return writeMessagesBlock(block, false);
+}
+
+Result JsonLinesWriter::writeDialogEnd() {
+	Expects(_messages != nullptr);
+
+	if (const auto result = writeMessagesBlock({}, true); !result) {
+		_messages = nullptr;
+		return result;
+	}
+	return base::take(_messages)->flush();
+}
+
 } // namespace Output
 } // namespace Export
@@ -23,6 +23,9 @@ struct JsonContext {
 
 	// Always fun to use std::vector<bool>.
 	std::vector<Type> nesting;
+
+	// Serialize objects and arrays without line breaks and indentation.
+	bool compact = false;
 };
 
 } // namespace details
@@ -60,7 +63,7 @@ public:
 
 	QString mainFilePath() override;
 
-private:
+protected:
 	using Context = details::JsonContext;
 	enum class DialogsMode {
 		None,
@@ -73,6 +76,9 @@ private:
 	[[nodiscard]] QByteArray prepareArrayItemStart();
 	[[nodiscard]] QByteArray popNesting();
 
+	[[nodiscard]] QByteArray prepareDialogStart(
+		const Data::DialogInfo &data);
+
 	[[nodiscard]] QString mainFileRelativePath() const;
 	[[nodiscard]] QString pathWithRelativePath(const QString &path) const;
 	[[nodiscard]] std::unique_ptr<File> fileWithRelativePath(
@@ -102,5 +108,40 @@ private:
 
 };
 
+// Same as JsonWriter, except that the messages of each chat are written
+// to a separate "messages.jsonl" file, one compact JSON object per line,
+// so that huge chats can be written and read back incrementally.
+//
+// The chat entry in "result.json" has the path of that file instead of
+// the "messages" array, a chat without messages gets an empty file.
+// Media paths inside it are relative to the export folder.
+//
+// When compressed, the files are gzip streams named "messages.jsonl.gz".
+class JsonLinesWriter final : public JsonWriter {
+public:
+	explicit JsonLinesWriter(bool compressed = false);
+	~JsonLinesWriter();
+
+	Format format() override {
+		return _compressor ? Format::JsonLinesGzip : Format::JsonLines;
+	}
+
+	Result writeDialogStart(const Data::DialogInfo &data) override;
+	Result writeDialogSlice(const Data::MessagesSlice &data) override;
+	Result writeDialogEnd() override;
+
+private:
+	class Compressor;
+
+	[[nodiscard]] Result writeMessagesBlock(
+		const QByteArray &block,
+		bool last);
+
+	Context _lineContext = { .compact = true };
+	std::unique_ptr<File> _messages;
+	std::unique_ptr<Compressor> _compressor;
+
+};
+
 } // namespace Output
 } // namespace Export
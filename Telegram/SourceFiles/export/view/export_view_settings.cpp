@@ -75,6 +75,12 @@ void ChooseFormatBox(
 	box->setTitle(tr::lng_export_option_choose_format());
 	addFormatOption(tr::lng_export_option_html(tr::now), Format::Html);
 	addFormatOption(tr::lng_export_option_json(tr::now), Format::Json);
+	addFormatOption(
+		tr::lng_export_option_jsonl(tr::now),
+		Format::JsonLines);
+	addFormatOption(
+		tr::lng_export_option_jsonl_gz(tr::now),
+		Format::JsonLinesGzip);
 	box->addButton(tr::lng_settings_save(), [=] { done(group->value()); });
 	box->addButton(tr::lng_cancel(), [=] { box->closeBox(); });
 }
@@ -252,6 +258,7 @@ void SettingsWidget::setupPathAndFormat(
 	if (_singlePeerId != 0) {
 		addFormatAndLocationLabel(container);
 		addLimitsLabel(container);
+		addIncrementalOption(container);
 		return;
 	}
 	const auto formatGroup = std::make_shared<Ui::RadioenumGroup<Format>>(
@@ -275,6 +282,36 @@ void SettingsWidget::setupPathAndFormat(
 	addLocationLabel(container);
 	addFormatOption(tr::lng_export_option_html(tr::now), Format::Html);
 	addFormatOption(tr::lng_export_option_json(tr::now), Format::Json);
+	addFormatOption(
+		tr::lng_export_option_jsonl(tr::now),
+		Format::JsonLines);
+	addFormatOption(
+		tr::lng_export_option_jsonl_gz(tr::now),
+		Format::JsonLinesGzip);
+	addIncrementalOption(container);
+}
+
+void SettingsWidget::addIncrementalOption(
+		not_null<Ui::VerticalLayout*> container) {
+	const auto checkbox = container->add(
+		object_ptr<Ui::Checkbox>(
+			container,
+			tr::lng_export_option_incremental(tr::now),
+			readData().incremental,
+			st::defaultBoxCheckbox),
+		st::exportSettingPadding);
+	container->add(
+		object_ptr<Ui::FlatLabel>(
+			container,
+			tr::lng_export_option_incremental_about(tr::now),
+			st::exportAboutOptionLabel),
+		st::exportAboutOptionPadding);
+	checkbox->checkedChanges(
+	) | rpl::start_with_next([=](bool checked) {
+		changeData([&](Settings &data) {
+			data.incremental = checked;
+		});
+	}, checkbox->lifetime());
 }
 
 void SettingsWidget::addLocationLabel(
@@ -342,7 +379,13 @@ void SettingsWidget::addFormatAndLocationLabel(
 		return data.format;
 	}) | rpl::distinct_until_changed(
 	) | rpl::map([](Format format) {
-		const auto text = (format == Format::Html) ? "HTML" : "JSON";
+		const auto text = (format == Format::Html)
+			? "HTML"
+			: (format == Format::Json)
+			? "JSON"
+			: (format == Format::JsonLines)
+			? "JSONL"
+			: "JSONL.GZ";
 		return Ui::Text::Link(text, u"internal:edit_format"_q);
 	});
 	const auto label = container->add(
@@ -239,6 +239,14 @@ const std::map<QString, Definition, std::greater<QString>> DefinitionMap {
 	{ "sticker_scale_both", {
 		.type = SettingType::BoolSetting,
 		.defaultValue = true, }},
+	{ "streaming_memory_limit", {
+		.type = SettingType::IntSetting,
+		.defaultValue = 64,
+		.limitHandler = IntLimit(16, 65536, 64), }},
+	{ "export_file_requests", {
+		.type = SettingType::IntSetting,
+		.defaultValue = 4,
+		.limitHandler = IntLimit(1, 16, 4), }},
 };
 
 using OldOptionKey = QString;
@@ -66,6 +66,8 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 namespace {
 
 constexpr auto kNewBlockEachMessage = 50;
+constexpr auto kResizeNearBlocks = 2;
+constexpr auto kResizeDuration = crl::time(8);
 constexpr auto kSkipCloudDraftsFor = TimeId(2);
 
 using UpdateFlag = Data::HistoryUpdate::Flag;
@@ -113,6 +115,10 @@ void History::setHasPendingResizedItems() {
 	_flags |= Flag::HasPendingResizedItems;
 }
 
+bool History::hasDeferredResize() const {
+	return _flags & Flag::HasDeferredResizedBlocks;
+}
+
 void History::itemRemoved(not_null<HistoryItem*> item) {
 	if (item == _joinedMessage) {
 		_joinedMessage = nullptr;
@@ -3018,16 +3024,43 @@ void History::resizeToWidth(int newWidth) {
 		: (_width != newWidth)
 		? Request::ResizeAll
 		: Request::ResizePending;
-	if (request == Request::ResizePending && !hasPendingResizedItems()) {
+	if (request == Request::ResizePending
+		&& !hasPendingResizedItems()
+		&& !hasDeferredResize()) {
 		return;
 	}
-	_flags &= ~(Flag::HasPendingResizedItems | Flag::PendingAllItemsResize);
+	_flags &= ~(Flag::HasPendingResizedItems
+		| Flag::PendingAllItemsResize
+		| Flag::HasDeferredResizedBlocks);
+
+	// Only the blocks near the scroll position are resized right away,
+	// others keep their old height until the following calls, each one
+	// taking a few milliseconds, so that a long history doesn't freeze
+	// the interface when the width changes.
+	const auto anchor = scrollTopItem
+		? scrollTopItem->block()->indexInHistory()
+		: (int(blocks.size()) - 1);
+	const auto till = crl::now() + kResizeDuration;
 
 	_width = newWidth;
 	int y = 0;
 	for (const auto &block : blocks) {
 		block->setY(y);
-		y += block->resizeGetHeight(newWidth, request);
+		const auto outdated = (block->width() > 0)
+			&& (block->width() != newWidth);
+		const auto blockRequest = (request == Request::ResizePending
+			&& outdated)
+			? Request::ResizeAll
+			: request;
+		if (blockRequest == Request::ResizeAll
+			&& outdated
+			&& std::abs(block->indexInHistory() - anchor) > kResizeNearBlocks
+			&& crl::now() >= till) {
+			_flags |= Flag::HasDeferredResizedBlocks;
+			y += block->height();
+			continue;
+		}
+		y += block->resizeGetHeight(newWidth, blockRequest);
 	}
 	_height = y;
 }
@@ -3380,6 +3413,7 @@ void History::clear(ClearType type) {
 		}
 		clearNotifications();
 		owner().notifyHistoryCleared(this);
+		session().local().clearHistoryCache(peer->id);
 		if (unreadCountKnown()) {
 			setUnreadCount(0);
 		}
@@ -3415,6 +3449,42 @@ void History::clear(ClearType type) {
 	owner().sendHistoryChangeNotifications();
 }
 
+void History::unloadOlderBlocks(int count) {
+	Expects(count > 0 && count < blocks.size());
+	Expects(!isBuildingFrontBlock());
+
+	// The unread bar position can't be found again without the messages
+	// above it, so we keep everything starting from the first unread.
+	for (const auto view : { _firstUnreadView, _unreadBarView }) {
+		if (view) {
+			count = std::min(count, view->block()->indexInHistory());
+		}
+	}
+	if (!count) {
+		return;
+	}
+	const auto keep = blocks[count].get();
+	const auto unloading = [&](HistoryView::Element *view) {
+		return view
+			&& (view->block()->indexInHistory() < keep->indexInHistory());
+	};
+	Assert(!unloading(scrollTopItem));
+
+	if (_joinedMessage && unloading(_joinedMessage->mainView())) {
+		removeJoinedMessage();
+	}
+	while (blocks.front().get() != keep) {
+		blocks.pop_front();
+	}
+	for (auto i = 0, l = int(blocks.size()); i != l; ++i) {
+		blocks[i]->setIndexInHistory(i);
+	}
+	blocks.front()->messages.front()->previousInBlocksChanged();
+	_loadedAtTop = false;
+
+	owner().notifyHistoryChangeDelayed(this);
+}
+
 void History::clearUpTill(MsgId availableMinId) {
 	auto remove = std::vector<not_null<HistoryItem*>>();
 	remove.reserve(_messages.size());
@@ -3529,6 +3599,7 @@ HistoryBlock::HistoryBlock(not_null<History*> history)
 }
 
 int HistoryBlock::resizeGetHeight(int newWidth, ResizeRequest request) {
+	_width = newWidth;
 	auto y = 0;
 	if (request == ResizeRequest::ReinitAll) {
 		for (const auto &message : messages) {
@@ -122,6 +122,10 @@ public:
 	void clear(ClearType type);
 	void clearUpTill(MsgId availableMinId);
 
+	// Destroys the views of the first blocks to free memory, the messages
+	// are shown again after they are requested the next time.
+	void unloadOlderBlocks(int count);
+
 	void applyGroupAdminChanges(const base::flat_set<UserId> &changes);
 
 	template <typename ...Args>
@@ -302,6 +306,10 @@ public:
 	bool hasPendingResizedItems() const;
 	void setHasPendingResizedItems();
 
+	// Some blocks far from the scroll position still have the old width,
+	// resizeToWidth() should be called again to continue resizing them.
+	[[nodiscard]] bool hasDeferredResize() const;
+
 	[[nodiscard]] auto sendActionPainter()
 	-> not_null<HistoryView::SendActionPainter*> override {
 		return &_sendActionPainter;
@@ -467,6 +475,7 @@ private:
 		FakeUnreadWhileOpened = (1 << 4),
 		HasPinnedMessages = (1 << 5),
 		ResolveChatListMessage = (1 << 6),
+		HasDeferredResizedBlocks = (1 << 7),
 	};
 	using Flags = base::flags<Flag>;
 	friend inline constexpr auto is_flag_type(Flag) {
@@ -673,6 +682,9 @@ public:
 	int height() const {
 		return _height;
 	}
+	int width() const {
+		return _width;
+	}
 	not_null<History*> history() const {
 		return _history;
 	}
@@ -707,6 +719,7 @@ protected:
 
 	int _y = 0;
 	int _height = 0;
+	int _width = 0;
 	int _indexInHistory = -1;
 
 };
@@ -72,6 +72,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "main/main_session_settings.h"
 #include "menu/menu_item_download_files.h"
 #include "core/application.h"
+#include "core/core_tracing.h"
 #include "apiwrap.h"
 #include "api/api_attached_stickers.h"
 #include "api/api_toggling_media.h"
@@ -111,6 +112,7 @@ namespace {
 constexpr auto kScrollDateHideTimeout = 1000;
 constexpr auto kUnloadHeavyPartsPages = 2;
 constexpr auto kClearUserpicsAfter = 50;
+constexpr auto kClearMediaPreloadedAfter = 500;
 
 // Helper binary search for an item in a list that is not completely
 // above the given top of the visible area or below the given bottom of the visible area
@@ -1007,6 +1009,8 @@ Ui::ChatPaintContext HistoryInner::preparePaintContext(
 }
 
 void HistoryInner::paintEvent(QPaintEvent *e) {
+	TRACE_SCOPE("HistoryInner::paintEvent");
+
 	if (_controller->contentOverlapped(this, e)
 		|| hasPendingResizedItems()) {
 		return;
@@ -3854,6 +3858,51 @@ void HistoryInner::updateDragSelection(Element *dragSelFrom, Element *dragSelTo,
 	update();
 }
 
+void HistoryInner::preloadMedia(int top, int bottom) {
+	if (_mediaPreloaded.size() > kClearMediaPreloadedAfter) {
+		_mediaPreloaded.clear();
+	}
+	const auto preload = [&](not_null<HistoryItem*> item) {
+		const auto media = item->media();
+		if (!media || !_mediaPreloaded.emplace(item->fullId()).second) {
+			return;
+		} else if (const auto photo = media->photo()) {
+			photo->load(
+				Data::PhotoSize::Thumbnail,
+				item->fullId(),
+				LoadFromCloudOrLocal,
+				true);
+		} else if (const auto document = media->document()) {
+			if (document->hasThumbnail()) {
+				document->loadThumbnail(item->fullId());
+			}
+		}
+	};
+	const auto preloadInHistory = [&](History *history, int historytop) {
+		if (!history || historytop < 0) {
+			return;
+		}
+		for (const auto &block : history->blocks) {
+			const auto blocktop = historytop + block->y();
+			if (blocktop >= bottom) {
+				break;
+			} else if (blocktop + block->height() <= top) {
+				continue;
+			}
+			for (const auto &view : block->messages) {
+				const auto itemtop = blocktop + view->y();
+				if (itemtop >= bottom) {
+					break;
+				} else if (itemtop + view->height() > top) {
+					preload(view->data());
+				}
+			}
+		}
+	};
+	preloadInHistory(_migrated, migratedTop());
+	preloadInHistory(_history, historyTop());
+}
+
 int HistoryInner::historyHeight() const {
 	int result = 0;
 	if (_history->isEmpty()) {
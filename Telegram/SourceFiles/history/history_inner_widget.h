@@ -173,6 +173,9 @@ public:
 	// updates history->scrollTopItem/scrollTopOffset
 	void visibleAreaUpdated(int top, int bottom);
 
+	// Starts loading media thumbnails of messages between top and bottom.
+	void preloadMedia(int top, int bottom);
+
 	int historyHeight() const;
 	int historyScrollTop() const;
 	int migratedTop() const;
@@ -463,6 +466,7 @@ private:
 	bool _isChatWide = false;
 
 	base::flat_set<not_null<const HistoryItem*>> _animatedStickersPlayed;
+	base::flat_set<FullMsgId> _mediaPreloaded;
 	base::flat_map<not_null<PeerData*>, Ui::PeerUserpicView> _userpics;
 	base::flat_map<not_null<PeerData*>, Ui::PeerUserpicView> _userpicsCache;
 	base::flat_map<MsgId, Ui::PeerUserpicView> _hiddenSenderUserpics;
@@ -55,6 +55,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "data/data_session.h"
 #include "data/data_message_reactions.h"
 #include "data/data_messages.h"
+#include "data/data_messages_text_index.h"
 #include "data/data_media_types.h"
 #include "data/data_folder.h"
 #include "data/data_forum.h"
@@ -2761,6 +2762,7 @@ void HistoryItem::setTextValue(TextWithEntities text) {
 	const auto had = !_text.empty();
 	_text = std::move(text);
 	RemoveComponents(HistoryMessageTranslation::Bit());
+	history()->owner().messagesTextIndex().refresh(this);
 	if (had) {
 		history()->owner().requestItemTextRefresh(this);
 	}
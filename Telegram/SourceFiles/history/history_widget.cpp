@@ -178,6 +178,12 @@ namespace {
 constexpr auto kMessagesPerPageFirst = 30;
 constexpr auto kMessagesPerPage = 50;
 constexpr auto kPreloadHeightsCount = 3; // when 3 screens to scroll left make a preload request
+constexpr auto kPreloadHeightsMax = 10;
+constexpr auto kPreloadAheadDuration = crl::time(1500);
+constexpr auto kScrollVelocityResetTimeout = crl::time(200);
+constexpr auto kResizeDeferredDelay = crl::time(16);
+constexpr auto kUnloadBlocksAbove = 20; // about 1000 messages
+constexpr auto kKeepBlocksAbove = 10;
 constexpr auto kScrollToVoiceAfterScrolledMs = 1000;
 constexpr auto kSkipRepaintWhileScrollMs = 100;
 constexpr auto kShowMembersDropdownTimeoutMs = 300;
@@ -222,6 +228,7 @@ HistoryWidget::HistoryWidget(
 	controller->chatStyle()->value(lifetime(), st::historyScroll),
 	false)
 , _updateHistoryItems([=] { updateHistoryItemsByTimer(); })
+, _resizeDeferredTimer([=] { continueDeferredResize(); })
 , _cornerButtons(
 	_scroll.data(),
 	controller->chatStyle(),
@@ -2286,6 +2293,9 @@ void HistoryWidget::showHistory(
 			|| (_migrated && _migrated->scrollTopItem)
 			|| _history->isReadyFor(_showAtMsgId)) {
 			historyLoaded();
+		} else if (showHistoryFromCache()) {
+			historyLoaded();
+			reconcileHistoryFromCache();
 		} else {
 			firstLoadMessages();
 			doneShow();
@@ -2540,6 +2550,10 @@ void HistoryWidget::clearAllLoadRequests() {
 		histories.cancelRequest(_preloadDownRequest);
 		_preloadDownRequest = 0;
 	}
+	if (_cacheReconcileRequest) {
+		histories.cancelRequest(_cacheReconcileRequest);
+		_cacheReconcileRequest = 0;
+	}
 }
 
 bool HistoryWidget::updateReplaceMediaButton() {
@@ -3208,6 +3222,7 @@ void HistoryWidget::messagesReceived(
 		if (_history->loadedAtBottom()) {
 			checkActivation();
 		}
+		saveHistoryCache(peer, messages);
 	} else if (_firstLoadRequest == requestId) {
 		if (toMigrated) {
 			_history->clear(History::ClearType::Unload);
@@ -3220,6 +3235,7 @@ void HistoryWidget::messagesReceived(
 			firstLoadMessages();
 			return;
 		}
+		saveHistoryCache(peer, messages);
 
 		historyLoaded();
 		injectSponsoredMessages();
@@ -3262,6 +3278,170 @@ void HistoryWidget::messagesReceived(
 	}
 }
 
+bool HistoryWidget::showHistoryFromCache() {
+	Expects(_history != nullptr);
+
+	if (_migrated
+		|| _history->unreadCount()
+		|| (_showAtMsgId != ShowAtUnreadMsgId
+			&& _showAtMsgId != ShowAtTheEndMsgId)) {
+		return false;
+	}
+	const auto last = _history->lastMessage();
+	if (!last || !last->isRegular()) {
+		return false;
+	}
+	const auto cached = session().local().readHistoryCache(_peer->id);
+	if (!cached) {
+		return false;
+	}
+	const auto apply = [&](
+			const MTPVector<MTPUser> &users,
+			const MTPVector<MTPChat> &chats,
+			const QVector<MTPMessage> &list) {
+		// The cached slice is useless if it doesn't reach the last message,
+		// we'd have to request the bottom of the history anyway.
+		if (ranges::find(list, last->id, IdFromMessage) == end(list)) {
+			return false;
+		}
+
+		// Don't overwrite fresh peer data with the cached one.
+		auto &owner = _history->owner();
+		for (const auto &user : users.v) {
+			const auto id = user.match([](const auto &data) {
+				return peerFromUser(data.vid());
+			});
+			if (!owner.peerLoaded(id)) {
+				owner.processUser(user);
+			}
+		}
+		for (const auto &chat : chats.v) {
+			const auto id = chat.match([](const MTPDchannel &data) {
+				return peerFromChannel(data.vid().v);
+			}, [](const MTPDchannelForbidden &data) {
+				return peerFromChannel(data.vid().v);
+			}, [](const auto &data) {
+				return peerFromChat(data.vid().v);
+			});
+			if (!owner.peerLoaded(id)) {
+				owner.processChat(chat);
+			}
+		}
+		_history->getReadyFor(ShowAtTheEndMsgId);
+		_history->addOlderSlice(list);
+		return _history->loadedAtBottom() && !_history->isEmpty();
+	};
+	return cached->match([](const MTPDmessages_messagesNotModified &) {
+		return false;
+	}, [&](const auto &data) {
+		return apply(data.vusers(), data.vchats(), data.vmessages().v);
+	});
+}
+
+void HistoryWidget::reconcileHistoryFromCache() {
+	Expects(_history != nullptr);
+
+	const auto history = _history;
+	const auto type = Data::Histories::RequestType::History;
+	auto &histories = history->owner().histories();
+	_cacheReconcileRequest = histories.sendRequest(history, type, [=](
+			Fn<void()> finish) {
+		return history->session().api().request(MTPmessages_GetHistory(
+			history->peer->input,
+			MTP_int(0), // offset_id
+			MTP_int(0), // offset_date
+			MTP_int(0), // add_offset
+			MTP_int(kMessagesPerPage),
+			MTP_int(0), // max_id
+			MTP_int(0), // min_id
+			MTP_long(0) // hash
+		)).done([=](const MTPmessages_Messages &result) {
+			_cacheReconcileRequest = 0;
+			applyHistoryCacheReconcile(history, result);
+			finish();
+		}).fail([=] {
+			_cacheReconcileRequest = 0;
+			finish();
+		}).send();
+	});
+}
+
+void HistoryWidget::applyHistoryCacheReconcile(
+		not_null<History*> history,
+		const MTPmessages_Messages &messages) {
+	const auto apply = [&](const QVector<MTPMessage> &list) {
+		if (list.isEmpty()) {
+			return;
+		}
+		auto &owner = history->owner();
+		auto ids = base::flat_set<MsgId>();
+		for (const auto &message : list) {
+			ids.emplace(IdFromMessage(message));
+			owner.updateEditedMessage(message);
+		}
+
+		// Everything in the fresh range that the server didn't return
+		// was deleted while we were showing the cached slice. Messages
+		// newer than the range could arrive while the request was sent.
+		const auto minId = *ids.begin();
+		const auto maxId = *ids.rbegin();
+		auto removed = std::vector<not_null<HistoryItem*>>();
+		for (const auto &block : history->blocks) {
+			for (const auto &view : block->messages) {
+				const auto item = view->data();
+				if (item->isRegular()
+					&& item->id >= minId
+					&& item->id <= maxId
+					&& !ids.contains(item->id)) {
+					removed.push_back(item);
+				}
+			}
+		}
+		for (const auto &item : removed) {
+			item->destroy();
+		}
+	};
+	messages.match([](const MTPDmessages_messagesNotModified &) {
+	}, [&](const MTPDmessages_channelMessages &data) {
+		if (const auto channel = history->peer->asChannel()) {
+			channel->ptsReceived(data.vpts().v);
+			channel->processTopics(data.vtopics());
+		}
+		history->owner().processUsers(data.vusers());
+		history->owner().processChats(data.vchats());
+		apply(data.vmessages().v);
+	}, [&](const auto &data) {
+		history->owner().processUsers(data.vusers());
+		history->owner().processChats(data.vchats());
+		apply(data.vmessages().v);
+	});
+	if (history == _history) {
+		saveHistoryCache(history->peer, messages);
+	}
+}
+
+void HistoryWidget::saveHistoryCache(
+		not_null<PeerData*> peer,
+		const MTPmessages_Messages &messages) {
+	if (peer != _peer || !_history->loadedAtBottom()) {
+		return;
+	}
+	const auto last = _history->lastMessage();
+	if (!last || !last->isRegular()) {
+		return;
+	}
+	const auto containsLast = messages.match([](
+			const MTPDmessages_messagesNotModified &) {
+		return false;
+	}, [&](const auto &data) {
+		const auto &list = data.vmessages().v;
+		return ranges::find(list, last->id, IdFromMessage) != end(list);
+	});
+	if (containsLast) {
+		session().local().writeHistoryCache(peer->id, messages);
+	}
+}
+
 void HistoryWidget::historyLoaded() {
 	_historyInited = false;
 	doneShow();
@@ -3547,6 +3727,9 @@ void HistoryWidget::delayedShowAt(MsgId showAtMsgId) {
 }
 
 void HistoryWidget::handleScroll() {
+	if (!_synteticScrollEvent) {
+		updateScrollVelocity();
+	}
 	if (!_itemsRevealHeight) {
 		preloadHistoryIfNeeded();
 	}
@@ -3568,6 +3751,19 @@ void HistoryWidget::handleScroll() {
 	}
 }
 
+void HistoryWidget::updateScrollVelocity() {
+	const auto delta = _scroll->scrollTop() - _lastScrollTop;
+	const auto duration = crl::now() - _lastScrolled;
+	if (!delta) {
+		return;
+	} else if (duration > kScrollVelocityResetTimeout) {
+		// Don't count a single jump after a pause as a fast scroll.
+		_scrollVelocity = 0.;
+	} else if (duration > 0) {
+		_scrollVelocity = (_scrollVelocity + delta / float64(duration)) / 2.;
+	}
+}
+
 bool HistoryWidget::isItemCompletelyHidden(HistoryItem *item) const {
 	const auto view = item ? item->mainView() : nullptr;
 	if (!view) {
@@ -3623,17 +3819,61 @@ void HistoryWidget::preloadHistoryByScroll() {
 	auto scrollTop = _scroll->scrollTop();
 	auto scrollTopMax = _scroll->scrollTopMax();
 	auto scrollHeight = _scroll->height();
-	if (scrollTop + kPreloadHeightsCount * scrollHeight >= scrollTopMax) {
+
+	// We get here not only from scroll events, like when a slice arrives,
+	// so forget the velocity of a scroll that has already stopped.
+	if (crl::now() - _lastScrolled > kScrollVelocityResetTimeout) {
+		_scrollVelocity = 0.;
+	}
+
+	// When scrolling fast we request the next slice earlier, so that it
+	// arrives before the scroll reaches the edge of the loaded messages.
+	const auto preload = kPreloadHeightsCount * scrollHeight;
+	const auto ahead = std::min(
+		int(std::abs(_scrollVelocity) * kPreloadAheadDuration),
+		(kPreloadHeightsMax - kPreloadHeightsCount) * scrollHeight);
+	const auto down = (_scrollVelocity > 0.) ? ahead : 0;
+	const auto up = (_scrollVelocity < 0.) ? ahead : 0;
+	if (scrollTop + preload + down >= scrollTopMax) {
 		loadMessagesDown();
 	}
-	if (scrollTop <= kPreloadHeightsCount * scrollHeight) {
+	if (scrollTop <= preload + up) {
 		loadMessages();
 	}
+	if (_list && down > 0) {
+		const auto from = scrollTop + scrollHeight;
+		_list->preloadMedia(from, from + down);
+	} else if (_list && up > 0) {
+		_list->preloadMedia(scrollTop - up, scrollTop);
+	}
+	unloadFarHistoryBlocks();
 	if (session().supportMode()) {
 		crl::on_main(this, [=] { checkSupportPreload(); });
 	}
 }
 
+void HistoryWidget::unloadFarHistoryBlocks() {
+	// Views of the messages far above the scroll position take memory
+	// in long sessions in active chats, unload them while reading below.
+	// The migrated history is shown above, so we keep everything there.
+	// Without scrollTopItem we're at the bottom of the history.
+	if (_history->isEmpty()
+		|| _preloadRequest
+		|| (_migrated && !_migrated->isEmpty())
+		|| _scrollToAnimation.animating()) {
+		return;
+	}
+	const auto anchor = _history->scrollTopItem;
+	const auto index = anchor
+		? anchor->block()->indexInHistory()
+		: (int(_history->blocks.size()) - 1);
+	if (index < kUnloadBlocksAbove) {
+		return;
+	}
+	_history->unloadOlderBlocks(index - kKeepBlocksAbove);
+	updateHistoryGeometry();
+}
+
 void HistoryWidget::checkSupportPreload(bool force) {
 	if (!_history
 		|| _firstLoadRequest
@@ -5478,6 +5718,15 @@ void HistoryWidget::handlePendingHistoryUpdate() {
 	}
 }
 
+void HistoryWidget::continueDeferredResize() {
+	if (_list
+		&& ((_history && _history->hasDeferredResize())
+			|| (_migrated && _migrated->hasDeferredResize()))) {
+		updateHistoryGeometry();
+		_list->update();
+	}
+}
+
 void HistoryWidget::resizeEvent(QResizeEvent *e) {
 	//updateTabbedSelectorSectionShown();
 	recountChatWidth();
@@ -5768,6 +6017,11 @@ void HistoryWidget::updateHistoryGeometry(
 	}
 	const auto toY = std::clamp(newScrollTop, 0, _scroll->scrollTopMax());
 	synteticScrollToY(toY);
+
+	if (_history->hasDeferredResize()
+		|| (_migrated && _migrated->hasDeferredResize())) {
+		_resizeDeferredTimer.callOnce(kResizeDeferredDelay);
+	}
 }
 
 void HistoryWidget::revealItemsCallback() {
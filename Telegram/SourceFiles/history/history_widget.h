@@ -382,6 +382,7 @@ private:
 	void sendWhenOnline();
 	[[nodiscard]] SendMenu::Type sendButtonMenuType() const;
 	void handlePendingHistoryUpdate();
+	void continueDeferredResize();
 	void fullInfoUpdated();
 	void toggleTabbedSelectorMode();
 	void recountChatWidth();
@@ -543,6 +544,15 @@ private:
 	void addMessagesToFront(not_null<PeerData*> peer, const QVector<MTPMessage> &messages);
 	void addMessagesToBack(not_null<PeerData*> peer, const QVector<MTPMessage> &messages);
 
+	[[nodiscard]] bool showHistoryFromCache();
+	void reconcileHistoryFromCache();
+	void applyHistoryCacheReconcile(
+		not_null<History*> history,
+		const MTPmessages_Messages &messages);
+	void saveHistoryCache(
+		not_null<PeerData*> peer,
+		const MTPmessages_Messages &messages);
+
 	void updateHistoryGeometry(bool initial = false, bool loadedDown = false, const ScrollChange &change = { ScrollChangeNone, 0 });
 	void updateListSize();
 	void startItemRevealAnimations();
@@ -593,6 +603,8 @@ private:
 	int countInitialScrollTop();
 	int countAutomaticScrollTop();
 	void preloadHistoryByScroll();
+	void updateScrollVelocity();
+	void unloadFarHistoryBlocks();
 	void checkReplyReturns();
 	void scrollToAnimationCallback(FullMsgId attachToId, int relativeTo);
 
@@ -691,6 +703,7 @@ private:
 	int _firstLoadRequest = 0; // Not real mtpRequestId.
 	int _preloadRequest = 0; // Not real mtpRequestId.
 	int _preloadDownRequest = 0; // Not real mtpRequestId.
+	int _cacheReconcileRequest = 0; // Not real mtpRequestId.
 
 	MsgId _delayedShowAtMsgId = -1;
 	int _delayedShowAtRequest = 0; // Not real mtpRequestId.
@@ -710,7 +723,9 @@ private:
 
 	int _lastScrollTop = 0; // gifs optimization
 	crl::time _lastScrolled = 0;
+	float64 _scrollVelocity = 0.; // pixels per ms, positive downwards
 	base::Timer _updateHistoryItems;
+	base::Timer _resizeDeferredTimer;
 
 	crl::time _lastUserScrolled = 0;
 	bool _synteticScrollEvent = false;
@@ -12,15 +12,16 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "ui/chat/attach/attach_prepare.h"
 #include "ui/painter.h"
 #include "core/file_location.h"
-#include "base/random.h"
 #include "base/invoke_queued.h"
 #include "logs.h"
 
 #include <QtCore/QBuffer>
-#include <QtCore/QAbstractEventDispatcher>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QThread>
 #include <QtCore/QFileInfo>
+#include <QtCore/QWaitCondition>
+
+#include <thread>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -33,9 +34,27 @@ namespace Media {
 namespace Clip {
 namespace {
 
-constexpr auto kClipThreadsCount = 8;
-constexpr auto kAverageGifSize = 320 * 240;
+constexpr auto kDecodeThreadsLimit = 8;
 constexpr auto kWaitBeforeGifPause = crl::time(200);
+constexpr auto kNeverMs = 86400 * crl::time(1000);
+
+struct FrameCounters {
+	std::atomic<int64> decoded = 0;
+	std::atomic<int64> late = 0;
+	std::atomic<int64> dropped = 0;
+};
+
+[[nodiscard]] FrameCounters &Counters() {
+	static auto result = FrameCounters();
+	return result;
+}
+
+[[nodiscard]] int DecodeThreadsCount() {
+	return std::clamp(
+		QThread::idealThreadCount() - 1,
+		1,
+		kDecodeThreadsLimit);
+}
 
 QImage PrepareFrame(
 		const FrameRequest &request,
@@ -116,30 +135,73 @@ enum class ProcessResult {
 	Paused,
 	Repaint,
 	CopyFrame,
+	Decode,
 	Wait,
 };
 
+// Decoding threads shared by all the readers. The reader with the
+// earliest frame deadline is decoded first, so a few heavy videos don't
+// delay the frames of the others the way fixed thread sharding did.
+class DecodePool final {
+public:
+	using Done = Fn<void(ReaderPrivate *reader, ProcessResult result)>;
+
+	DecodePool(int threads, Done done);
+	~DecodePool();
+
+	[[nodiscard]] int threads() const {
+		return int(_threads.size());
+	}
+	void push(ReaderPrivate *reader, crl::time deadline);
+	void stop();
+
+private:
+	struct Task {
+		ReaderPrivate *reader = nullptr;
+		crl::time deadline = 0;
+	};
+
+	void work();
+
+	const Done _done;
+	QMutex _mutex;
+	QWaitCondition _wake;
+	std::vector<Task> _tasks; // Heap with the earliest deadline on top.
+	std::vector<std::thread> _threads;
+	bool _stopping = false;
+
+};
+
+// Tracks the readers and their frame timings in its own thread and
+// sends them to the DecodePool when a new frame should be decoded.
 class Manager final : public QObject {
 public:
 	explicit Manager(not_null<QThread*> thread);
 	~Manager();
 
-	int loadLevel() const {
-		return _loadLevel;
-	}
 	void append(Reader *reader, const Core::FileLocation &location, const QByteArray &data);
 	void start(Reader *reader);
 	void update(Reader *reader);
 	void stop(Reader *reader);
 	bool carries(Reader *reader) const;
 
+	[[nodiscard]] int readersCount() const;
+	[[nodiscard]] int decodeThreads() const;
+
 private:
+	struct Decoded {
+		ReaderPrivate *reader = nullptr;
+		ProcessResult result = ProcessResult::Wait;
+	};
+
 	void process();
 	void finish();
 	void callback(Reader *reader, Notification notification);
 	void clear();
+	void decode(ReaderPrivate *reader);
+	void decoded(ReaderPrivate *reader, ProcessResult result);
+	void applyDecoded(crl::time ms);
 
-	QAtomicInt _loadLevel;
 	using ReaderPointers = QMap<Reader*, QAtomicInt>;
 	ReaderPointers _readerPointers;
 	mutable QMutex _readerPointersMutex;
@@ -149,19 +211,17 @@ private:
 
 	bool handleProcessResult(ReaderPrivate *reader, ProcessResult result, crl::time ms);
 
-	enum ResultHandleState {
-		ResultHandleRemove,
-		ResultHandleStop,
-		ResultHandleContinue,
-	};
-	ResultHandleState handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms);
+	// Returns false if the reader should be removed.
+	bool handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms);
 
 	using Readers = QMap<ReaderPrivate*, crl::time>;
 	Readers _readers;
 
+	DecodePool _pool;
+	std::vector<Decoded> _decoded;
+	QMutex _decodedMutex;
+
 	QTimer _timer;
-	QThread *_processingInThread = nullptr;
-	bool _needReProcess = false;
 
 };
 
@@ -180,7 +240,7 @@ struct Worker {
 	Manager manager;
 };
 
-std::vector<std::unique_ptr<Worker>>  Workers;
+std::unique_ptr<Worker> Scheduler;
 
 } // namespace
 
@@ -203,21 +263,10 @@ Reader::Reader(const QByteArray &data, Callback &&callback)
 }
 
 void Reader::init(const Core::FileLocation &location, const QByteArray &data) {
-	if (Workers.size() < kClipThreadsCount) {
-		_threadIndex = Workers.size();
-		Workers.push_back(std::make_unique<Worker>());
-	} else {
-		_threadIndex = base::RandomIndex(Workers.size());
-		auto loadLevel = 0x7FFFFFFF;
-		for (int i = 0, l = int(Workers.size()); i < l; ++i) {
-			const auto level = Workers[i]->manager.loadLevel();
-			if (level < loadLevel) {
-				_threadIndex = i;
-				loadLevel = level;
-			}
-		}
+	if (!Scheduler) {
+		Scheduler = std::make_unique<Worker>();
 	}
-	Workers[_threadIndex]->manager.append(this, location, data);
+	Scheduler->manager.append(this, location, data);
 }
 
 Reader::Frame *Reader::frameToShow(int32 *index) const { // 0 means not ready
@@ -294,20 +343,17 @@ void Reader::moveToNextWrite() const {
 	}
 }
 
-void Reader::SafeCallback(
-		Reader *reader,
-		int threadIndex,
-		Notification notification) {
+void Reader::SafeCallback(Reader *reader, Notification notification) {
 	// Check if reader is not deleted already
-	if (Workers.size() > threadIndex
-		&& Workers[threadIndex]->manager.carries(reader)
+	if (Scheduler
+		&& Scheduler->manager.carries(reader)
 		&& reader->_callback) {
 		reader->_callback(Notification(notification));
 	}
 }
 
 void Reader::start(FrameRequest request) {
-	if (Workers.size() <= _threadIndex) {
+	if (!Scheduler) {
 		error();
 	}
 	if (_state == State::Error
@@ -322,7 +368,7 @@ void Reader::start(FrameRequest request) {
 	}
 	_frames[0].request = _frames[1].request = _frames[2].request = request;
 	moveToNextShow();
-	Workers[_threadIndex]->manager.start(this);
+	Scheduler->manager.start(this);
 }
 
 Reader::FrameInfo Reader::frameInfo(FrameRequest request, crl::time now) {
@@ -338,10 +384,10 @@ Reader::FrameInfo Reader::frameInfo(FrameRequest request, crl::time now) {
 		frame->displayed.storeRelease(1);
 		if (_autoPausedGif.loadAcquire()) {
 			_autoPausedGif.storeRelease(0);
-			if (Workers.size() <= _threadIndex) {
+			if (!Scheduler) {
 				error();
 			} else if (_state != State::Error) {
-				Workers[_threadIndex]->manager.update(this);
+				Scheduler->manager.update(this);
 			}
 		}
 	} else {
@@ -379,10 +425,10 @@ Reader::FrameInfo Reader::frameInfo(FrameRequest request, crl::time now) {
 		auto other = frameToWriteNext(true);
 		if (other) other->request = frame->request;
 
-		if (Workers.size() <= _threadIndex) {
+		if (!Scheduler) {
 			error();
 		} else if (_state != State::Error) {
-			Workers[_threadIndex]->manager.update(this);
+			Scheduler->manager.update(this);
 		}
 	}
 	return { frame->prepared, frame->index };
@@ -414,13 +460,13 @@ crl::time Reader::getDurationMs() const {
 }
 
 void Reader::pauseResumeVideo() {
-	if (Workers.size() <= _threadIndex) {
+	if (!Scheduler) {
 		error();
 	}
 	if (_state == State::Error) return;
 
 	_videoPauseRequest.storeRelease(1 - _videoPauseRequest.loadAcquire());
-	Workers[_threadIndex]->manager.start(this);
+	Scheduler->manager.start(this);
 }
 
 bool Reader::videoPaused() const {
@@ -440,11 +486,11 @@ State Reader::state() const {
 }
 
 void Reader::stop() {
-	if (Workers.size() <= _threadIndex) {
+	if (!Scheduler) {
 		error();
 	}
 	if (_state != State::Error) {
-		Workers[_threadIndex]->manager.stop(this);
+		Scheduler->manager.stop(this);
 		_width = _height = 0;
 	}
 }
@@ -531,7 +577,9 @@ public:
 		}
 
 		if (!_request.valid()) {
-			return start(ms);
+			return frame()->original.isNull()
+				? ProcessResult::Decode
+				: ProcessResult::Wait;
 		}
 		if (!_started) {
 			_started = true;
@@ -543,7 +591,17 @@ public:
 		return ProcessResult::Wait;
 	}
 
+	// Called in a DecodePool thread.
+	ProcessResult decode(crl::time ms) {
+		return _request.valid() ? finishProcess(ms) : start(ms);
+	}
+
+	[[nodiscard]] crl::time decodeDeadline() const {
+		return _nextFrameWhen + _frameDelay;
+	}
+
 	ProcessResult finishProcess(crl::time ms) {
+		const auto previousFrameWhen = _nextFrameWhen;
 		auto frameMs = _seekPositionMs + ms - _animationStarted;
 		auto readResult = _implementation->readFramesTill(frameMs, ms);
 		if (readResult == internal::ReaderImplementation::ReadResult::EndOfFile) {
@@ -561,12 +619,32 @@ public:
 			_nextFrameWhen = 1;
 		}
 
+		_frameDelay = std::max(_nextFrameWhen - previousFrameWhen, crl::time(0));
+
 		if (!renderFrame()) {
 			return error();
 		}
+		countFrame();
 		return ProcessResult::CopyFrame;
 	}
 
+	void countFrame() {
+		auto &counters = Counters();
+		counters.decoded.fetch_add(1, std::memory_order_relaxed);
+		if (crl::now() > _nextFrameWhen) {
+			counters.late.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Frames skipped by readFramesTill() to keep up with the time.
+		const auto index = frame()->index;
+		if (_lastFrameIndex >= 0 && index > _lastFrameIndex + 1) {
+			counters.dropped.fetch_add(
+				index - _lastFrameIndex - 1,
+				std::memory_order_relaxed);
+		}
+		_lastFrameIndex = index;
+	}
+
 	bool renderFrame() {
 		Expects(_request.valid());
 
@@ -682,16 +760,85 @@ private:
 	crl::time _animationStarted = 0;
 	crl::time _nextFrameWhen = 0;
 	crl::time _nextFramePositionMs = 0;
+	crl::time _frameDelay = 0;
+	int _lastFrameIndex = -1;
 
 	bool _autoPausedGif = false;
 	bool _started = false;
+	bool _decoding = false; // Accessed only by the Manager thread.
 	crl::time _videoPausedAtMs = 0;
 
 	friend class Manager;
 
 };
 
-Manager::Manager(not_null<QThread*> thread) {
+DecodePool::DecodePool(int threads, Done done)
+: _done(std::move(done)) {
+	_threads.reserve(threads);
+	for (auto i = 0; i != threads; ++i) {
+		_threads.emplace_back([=] { work(); });
+	}
+}
+
+DecodePool::~DecodePool() {
+	stop();
+}
+
+void DecodePool::push(ReaderPrivate *reader, crl::time deadline) {
+	{
+		QMutexLocker lock(&_mutex);
+		_tasks.push_back({ .reader = reader, .deadline = deadline });
+		std::push_heap(begin(_tasks), end(_tasks), [](
+				const Task &a,
+				const Task &b) {
+			return (a.deadline > b.deadline);
+		});
+	}
+	_wake.wakeOne();
+}
+
+void DecodePool::stop() {
+	{
+		QMutexLocker lock(&_mutex);
+		_stopping = true;
+		_tasks.clear();
+	}
+	_wake.wakeAll();
+	for (auto &thread : _threads) {
+		thread.join();
+	}
+	_threads.clear();
+}
+
+void DecodePool::work() {
+	QMutexLocker lock(&_mutex);
+	while (true) {
+		while (!_stopping && _tasks.empty()) {
+			_wake.wait(&_mutex);
+		}
+		if (_stopping) {
+			return;
+		}
+		std::pop_heap(begin(_tasks), end(_tasks), [](
+				const Task &a,
+				const Task &b) {
+			return (a.deadline > b.deadline);
+		});
+		const auto reader = _tasks.back().reader;
+		_tasks.pop_back();
+
+		lock.unlock();
+		_done(reader, reader->decode(crl::now()));
+		lock.relock();
+	}
+}
+
+Manager::Manager(not_null<QThread*> thread)
+: _pool(DecodeThreadsCount(), [=](
+		ReaderPrivate *reader,
+		ProcessResult result) {
+	decoded(reader, result);
+}) {
 	moveToThread(thread);
 	connect(thread, &QThread::started, this, [=] { process(); });
 	connect(thread, &QThread::finished, this, [=] { finish(); });
@@ -703,7 +850,6 @@ Manager::Manager(not_null<QThread*> thread) {
 
 void Manager::append(Reader *reader, const Core::FileLocation &location, const QByteArray &data) {
 	reader->_private = new ReaderPrivate(reader, location, data);
-	_loadLevel.fetchAndAddRelaxed(kAverageGifSize);
 	update(reader);
 }
 
@@ -735,6 +881,15 @@ bool Manager::carries(Reader *reader) const {
 	return _readerPointers.contains(reader);
 }
 
+int Manager::readersCount() const {
+	QMutexLocker lock(&_readerPointersMutex);
+	return int(_readerPointers.size());
+}
+
+int Manager::decodeThreads() const {
+	return _pool.threads();
+}
+
 auto Manager::unsafeFindReaderPointer(ReaderPrivate *reader)
 -> ReaderPointers::iterator {
 	const auto it = _readerPointers.find(reader->_interface);
@@ -756,11 +911,47 @@ auto Manager::constUnsafeFindReaderPointer(ReaderPrivate *reader) const
 }
 
 void Manager::callback(Reader *reader, Notification notification) {
-	crl::on_main([=, threadIndex = reader->threadIndex()] {
-		Reader::SafeCallback(reader, threadIndex, notification);
+	crl::on_main([=] {
+		Reader::SafeCallback(reader, notification);
 	});
 }
 
+void Manager::decode(ReaderPrivate *reader) {
+	Expects(!reader->_decoding);
+
+	reader->_decoding = true;
+	_pool.push(reader, reader->decodeDeadline());
+}
+
+void Manager::decoded(ReaderPrivate *reader, ProcessResult result) {
+	{
+		QMutexLocker lock(&_decodedMutex);
+		_decoded.push_back({ .reader = reader, .result = result });
+	}
+	InvokeQueued(this, [=] { process(); });
+}
+
+void Manager::applyDecoded(crl::time ms) {
+	auto decoded = std::vector<Decoded>();
+	{
+		QMutexLocker lock(&_decodedMutex);
+		decoded = base::take(_decoded);
+	}
+	for (const auto &[reader, result] : decoded) {
+		const auto i = _readers.find(reader);
+		Assert(i != _readers.end());
+
+		reader->_decoding = false;
+		if (!handleResult(reader, result, ms)) {
+			delete reader;
+			_readers.erase(i);
+		} else {
+			// Let process() decide when the next frame is needed.
+			i.value() = ms;
+		}
+	}
+}
+
 bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, crl::time ms) {
 	QMutexLocker lock(&_readerPointersMutex);
 	auto it = unsafeFindReaderPointer(reader);
@@ -783,7 +974,6 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 	}
 
 	if (result == ProcessResult::Started) {
-		_loadLevel.fetchAndAddRelaxed(reader->_width * reader->_height - kAverageGifSize);
 		it.key()->_durationMs = reader->_durationMs;
 	}
 	// See if we need to pause GIF because it is not displayed right now.
@@ -824,16 +1014,13 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 	return true;
 }
 
-Manager::ResultHandleState Manager::handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms) {
-	if (!handleProcessResult(reader, result, ms)) {
-		_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : kAverageGifSize));
-		delete reader;
-		return ResultHandleRemove;
-	}
 
-	_processingInThread->eventDispatcher()->processEvents(QEventLoop::AllEvents);
-	if (_processingInThread->isInterruptionRequested()) {
-		return ResultHandleStop;
+bool Manager::handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms) {
+	if (result == ProcessResult::Decode) {
+		decode(reader);
+		return true;
+	} else if (!handleProcessResult(reader, result, ms)) {
+		return false;
 	}
 
 	if (result == ProcessResult::Repaint) {
@@ -851,23 +1038,19 @@ Manager::ResultHandleState Manager::handleResult(ReaderPrivate *reader, ProcessR
 				reader->_frame = index;
 			}
 		}
-		return handleResult(reader, reader->finishProcess(ms), ms);
+		decode(reader);
 	}
-
-	return ResultHandleContinue;
+	return true;
 }
 
 void Manager::process() {
-	if (_processingInThread) {
-		_needReProcess = true;
-		return;
-	}
-
 	_timer.stop();
-	_processingInThread = thread();
+
+	auto ms = crl::now();
+	applyDecoded(ms);
 
 	bool checkAllReaders = false;
-	auto ms = crl::now(), minms = ms + 86400 * crl::time(1000);
+	auto minms = ms + kNeverMs;
 	{
 		QMutexLocker lock(&_readerPointersMutex);
 		for (auto it = _readerPointers.begin(), e = _readerPointers.end(); it != e; ++it) {
@@ -875,6 +1058,9 @@ void Manager::process() {
 				auto i = _readers.find(it.key()->_private);
 				if (i == _readers.cend()) {
 					_readers.insert(it.key()->_private, 0);
+				} else if (i.key()->_decoding) {
+					// Apply the changes when the frame is decoded.
+					continue;
 				} else {
 					i.value() = ms;
 					if (i.key()->_autoPausedGif && !it.key()->_autoPausedGif.loadAcquire()) {
@@ -896,28 +1082,29 @@ void Manager::process() {
 
 	for (auto i = _readers.begin(), e = _readers.end(); i != e;) {
 		ReaderPrivate *reader = i.key();
-		if (i.value() <= ms) {
-			ResultHandleState state = handleResult(reader, reader->process(ms), ms);
-			if (state == ResultHandleRemove) {
+		if (reader->_decoding) {
+			++i;
+			continue;
+		} else if (i.value() <= ms) {
+			if (!handleResult(reader, reader->process(ms), ms)) {
+				delete reader;
 				i = _readers.erase(i);
 				continue;
-			} else if (state == ResultHandleStop) {
-				_processingInThread = nullptr;
-				return;
+			} else if (reader->_decoding) {
+				++i;
+				continue;
 			}
-			ms = crl::now();
 			if (reader->_videoPausedAtMs) {
-				i.value() = ms + 86400 * 1000ULL;
+				i.value() = ms + kNeverMs;
 			} else if (reader->_nextFrameWhen && reader->_started) {
 				i.value() = reader->_nextFrameWhen;
 			} else {
-				i.value() = (ms + 86400 * 1000ULL);
+				i.value() = ms + kNeverMs;
 			}
 		} else if (checkAllReaders) {
 			QMutexLocker lock(&_readerPointersMutex);
 			auto it = constUnsafeFindReaderPointer(reader);
 			if (it == _readerPointers.cend()) {
-				_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : kAverageGifSize));
 				delete reader;
 				i = _readers.erase(i);
 				continue;
@@ -930,17 +1117,11 @@ void Manager::process() {
 	}
 
 	ms = crl::now();
-	if (_needReProcess || minms <= ms) {
-		_needReProcess = false;
-		_timer.start(1);
-	} else {
-		_timer.start(minms - ms);
-	}
-
-	_processingInThread = nullptr;
+	_timer.start(std::max(minms - ms, crl::time(1)));
 }
 
 void Manager::finish() {
+	_pool.stop();
 	_timer.stop();
 	clear();
 }
@@ -958,9 +1139,11 @@ void Manager::clear() {
 		delete i.key();
 	}
 	_readers.clear();
+	_decoded.clear();
 }
 
 Manager::~Manager() {
+	_pool.stop();
 	clear();
 }
 
@@ -1005,8 +1188,22 @@ Ui::PreparedFileInformation PrepareForSending(
 	return { .media = result };
 }
 
+Statistics CurrentStatistics() {
+	const auto &counters = Counters();
+	auto result = Statistics{
+		.decoded = counters.decoded.load(std::memory_order_relaxed),
+		.late = counters.late.load(std::memory_order_relaxed),
+		.dropped = counters.dropped.load(std::memory_order_relaxed),
+	};
+	if (Scheduler) {
+		result.readers = Scheduler->manager.readersCount();
+		result.threads = Scheduler->manager.decodeThreads();
+	}
+	return result;
+}
+
 void Finish() {
-	Workers.clear();
+	Scheduler = nullptr;
 }
 
 Reader *const ReaderPointer::BadPointer = reinterpret_cast<Reader*>(1);
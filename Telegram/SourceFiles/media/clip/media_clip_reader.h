@@ -73,10 +73,7 @@ public:
 	Reader(const QByteArray &data, Callback &&callback);
 
 	// Reader can be already deleted.
-	static void SafeCallback(
-		Reader *reader,
-		int threadIndex,
-		Notification notification);
+	static void SafeCallback(Reader *reader, Notification notification);
 
 	void start(FrameRequest request);
 
@@ -109,9 +106,6 @@ public:
 		return _autoPausedGif.loadAcquire();
 	}
 	[[nodiscard]] bool videoPaused() const;
-	[[nodiscard]] int threadIndex() const {
-		return _threadIndex;
-	}
 
 	[[nodiscard]] int width() const;
 	[[nodiscard]] int height() const;
@@ -173,7 +167,6 @@ private:
 
 	QAtomicInt _autoPausedGif = 0;
 	QAtomicInt _videoPauseRequest = 0;
-	int32 _threadIndex;
 
 	friend class Manager;
 
@@ -243,6 +236,15 @@ inline ReaderPointer MakeReader(Args&&... args) {
 	const QString &fname,
 	const QByteArray &data);
 
+struct Statistics {
+	int readers = 0;
+	int threads = 0;
+	int64 decoded = 0;
+	int64 late = 0; // Decoded after the time they should've been shown.
+	int64 dropped = 0; // Skipped to keep up with the time.
+};
+[[nodiscard]] Statistics CurrentStatistics();
+
 void Finish();
 
 } // namespace Clip
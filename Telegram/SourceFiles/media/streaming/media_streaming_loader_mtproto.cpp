@@ -119,7 +119,9 @@ bool LoaderMtproto::readyToRequest() const {
 	return !_requested.empty();
 }
 
-int64 LoaderMtproto::takeNextRequestOffset() {
+int64 LoaderMtproto::takeNextRequestOffset(int limit) {
+	Expects(limit == kPartSize);
+
 	const auto offset = _requested.take();
 
 	Ensures(offset.has_value());
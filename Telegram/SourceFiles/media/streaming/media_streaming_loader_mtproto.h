@@ -43,7 +43,7 @@ public:
 
 private:
 	bool readyToRequest() const override;
-	int64 takeNextRequestOffset() override;
+	int64 takeNextRequestOffset(int limit) override;
 	bool feedPart(int64 offset, const QByteArray &bytes) override;
 	void cancelOnFail() override;
 
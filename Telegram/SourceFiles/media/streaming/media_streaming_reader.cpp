@@ -10,6 +10,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "media/streaming/media_streaming_common.h"
 #include "media/streaming/media_streaming_loader.h"
 #include "storage/cache/storage_cache_database.h"
+#include "core/core_tracing.h"
 
 namespace Media {
 namespace Streaming {
@@ -21,7 +22,9 @@ constexpr auto kInSlice = uint32(kPartsInSlice * kPartSize);
 constexpr auto kMaxPartsInHeader = 64;
 constexpr auto kMaxOnlyInHeader = 80 * kPartSize;
 constexpr auto kPartsOutsideFirstSliceGood = 8;
-constexpr auto kSlicesInMemory = 2;
+
+// Fewer slices are not unloaded even if the memory limit is exceeded.
+constexpr auto kMinSlicesInMemory = 2;
 
 // 1 MB of parts are requested from cloud ahead of reading demand.
 constexpr auto kPreloadPartsAhead = 8;
@@ -34,6 +37,14 @@ struct ParsedCacheEntry {
 	std::optional<PartsMap> included;
 };
 
+int64 PartsBytes(const PartsMap &parts) {
+	auto result = int64();
+	for (const auto &[offset, bytes] : parts) {
+		result += bytes.size();
+	}
+	return result;
+}
+
 bool IsContiguousSerialization(int serializedSize, int maxSliceSize) {
 	return !(serializedSize % kPartSize) || (serializedSize == maxSliceSize);
 }
@@ -340,8 +351,12 @@ auto Reader::Slice::offsetsFromLoader(uint32 from, uint32 till) const
 	return result;
 }
 
-Reader::Slices::Slices(uint32 size, bool useCache)
-: _size(size) {
+Reader::Slices::Slices(
+	uint32 size,
+	bool useCache,
+	Fn<void()> requestUnload)
+: _size(size)
+, _memory(std::move(requestUnload)) {
 	Expects(size > 0);
 
 	if (useCache) {
@@ -421,6 +436,7 @@ void Reader::Slices::applyHeaderCacheData() {
 			_data[index].addPart(
 				offset - index * kInSlice,
 				base::duplicate(part));
+			changeMemoryUsage(part.size());
 		}
 	};
 	if (_header.parts.empty()) {
@@ -456,7 +472,9 @@ void Reader::Slices::processCacheResult(int sliceNumber, PartsMap &&result) {
 		// We could've already unloaded this slice using LRU _usedSlices.
 		return;
 	}
+	const auto was = PartsBytes(slice.parts);
 	slice.processCacheData(std::move(result));
+	changeMemoryUsage(PartsBytes(slice.parts) - was);
 	checkSliceFullLoaded(sliceNumber);
 	if (!sliceNumber) {
 		applyHeaderCacheData();
@@ -532,19 +550,23 @@ void Reader::Slices::processPart(
 		QByteArray &&bytes) {
 	Expects(isFullInHeader() || (offset / kInSlice < _data.size()));
 
+	const auto size = int64(bytes.size());
 	if (isFullInHeader()) {
 		_header.addPart(offset, bytes);
+		changeMemoryUsage(size);
 		checkSliceFullLoaded(0);
 		return;
 	} else if (_headerMode == HeaderMode::Unknown) {
 		if (_header.parts.contains(offset)) {
 			return;
 		} else if (_header.parts.size() < kMaxPartsInHeader) {
+			// Shares the bytes with the slice part, don't count it twice.
 			_header.addPart(offset, bytes);
 		}
 	}
 	const auto index = offset / kInSlice;
 	_data[index].addPart(offset - index * kInSlice, std::move(bytes));
+	changeMemoryUsage(size);
 	checkSliceFullLoaded(index + 1);
 }
 
@@ -709,15 +731,27 @@ int Reader::Slices::maxSliceSize(int sliceNumber) const {
 	return MaxSliceSize(sliceNumber, _size);
 }
 
-Reader::SerializedSlice Reader::Slices::serializeAndUnloadUnused() {
+bool Reader::Slices::unloadUnusedRequired(bool idle) const {
+	const auto keep = idle ? 0 : kMinSlicesInMemory;
+	return (_headerMode != HeaderMode::Unknown)
+		&& (_usedSlices.size() > keep)
+		&& _memory.shouldUnload();
+}
+
+void Reader::Slices::unloadRequestHandled() {
+	_memory.unloadRequestHandled();
+}
+
+Reader::SerializedSlice Reader::Slices::serializeAndUnloadUnused(
+		bool idle) {
 	using Flag = Slice::Flag;
 
-	if (_headerMode == HeaderMode::Unknown
-		|| _usedSlices.size() <= kSlicesInMemory) {
+	if (!unloadUnusedRequired(idle)) {
 		return {};
 	}
 	const auto purgeSlice = _usedSlices.front();
 	_usedSlices.pop_front();
+	_memory.unloaded();
 	if (!(_data[purgeSlice].flags & Flag::LoadedFromCache)) {
 		// If the only data in this slice was from _header, just leave it.
 		return {};
@@ -798,7 +832,8 @@ Reader::SerializedSlice Reader::Slices::serializeAndUnloadSlice(
 	return result;
 }
 
-void Reader::Slices::unloadSlice(Slice &slice) const {
+void Reader::Slices::unloadSlice(Slice &slice) {
+	changeMemoryUsage(-PartsBytes(slice.parts));
 	const auto full = (slice.flags & Slice::Flag::FullInCache);
 	slice = Slice();
 	if (full) {
@@ -831,13 +866,34 @@ QByteArray Reader::Slices::serializeAndUnloadFirstSliceNoHeader() {
 
 	auto &slice = _data[0];
 	for (const auto &[offset, part] : _header.parts) {
-		slice.parts.erase(offset);
+		if (const auto i = slice.parts.find(offset); i != end(slice.parts)) {
+			changeMemoryUsage(-i->second.size());
+			slice.parts.erase(i);
+		}
 	}
 	auto result = serializeComplexSlice(slice);
 	unloadSlice(slice);
 	return result;
 }
 
+void Reader::Slices::changeMemoryUsage(int64 delta) {
+	_memoryUsage += delta;
+	_memoryPeak = std::max(_memoryPeak, _memoryUsage);
+	_memory.changeUsage(delta);
+}
+
+void Reader::Slices::setMemoryPriority(int priority) {
+	_memory.setPriority(priority);
+}
+
+int64 Reader::Slices::memoryUsage() const {
+	return _memoryUsage;
+}
+
+int64 Reader::Slices::memoryPeak() const {
+	return _memoryPeak;
+}
+
 Reader::SerializedSlice Reader::Slices::unloadToCache() {
 	if (_headerMode == HeaderMode::Unknown
 		|| _headerMode == HeaderMode::NoCache) {
@@ -860,7 +916,15 @@ Reader::Reader(
 : _loader(std::move(loader))
 , _cache(cache)
 , _cacheHelper(cache ? InitCacheHelper(_loader->baseCacheKey()) : nullptr)
-, _slices(_loader->size(), _cacheHelper != nullptr) {
+, _slices(_loader->size(), _cacheHelper != nullptr, [=] {
+	// Active readers check the request themselves in fill().
+	crl::on_main(this, [=] {
+		if (!_streamingActive) {
+			unloadSlicesOverLimit();
+		}
+	});
+})
+, _partsReceived((_loader->size() + kPartSize - 1) / kPartSize) {
 	_loader->parts(
 	) | rpl::start_with_next([=](LoadedPart &&part) {
 		if (_attachedDownloader) {
@@ -924,6 +988,7 @@ void Reader::stopStreaming(bool stillActive) {
 		refreshLoaderPriority();
 		_loadingOffsets.clear();
 		processDownloaderRequests();
+		unloadSlicesOverLimit();
 	}
 }
 
@@ -1120,7 +1185,9 @@ void Reader::setLoaderPriority(int priority) {
 }
 
 void Reader::refreshLoaderPriority() {
-	_loader->setPriority(_streamingActive ? _realPriority : 0);
+	const auto priority = _streamingActive ? _realPriority : 0;
+	_loader->setPriority(priority);
+	_slices.setMemoryPriority(priority);
 }
 
 bool Reader::isRemoteLoader() const {
@@ -1156,6 +1223,8 @@ void Reader::readFromCache(int sliceNumber) {
 			result = std::move(result),
 			sizes = std::move(sizes)
 		]() mutable{
+			TRACE_SCOPE("Streaming::ParseCacheEntry");
+
 			auto entry = ParseCacheEntry(
 				bytes::make_span(result),
 				sliceNumber,
@@ -1184,6 +1253,7 @@ void Reader::readFromCache(int sliceNumber) {
 		keys.push_back(_cacheHelper->key(i + 1));
 	}
 	_cache->getWithSizes(key, std::move(keys), ready);
+	++_statistics.slicesReadFromCache;
 }
 
 bool Reader::readFromCacheForDownloader(int sliceNumber) {
@@ -1203,6 +1273,32 @@ void Reader::putToCache(SerializedSlice &&slice) {
 	Expects(slice.number >= 0);
 
 	_cache->put(_cacheHelper->key(slice.number), std::move(slice.data));
+	++_statistics.slicesPutToCache;
+}
+
+void Reader::putUnloadedToCache(SerializedSlice &&slice) {
+	if (!_cacheHelper || slice.number < 0) {
+		return;
+	}
+	// If we put to cache the header (number == 0) that means we're in
+	// HeaderMode::Good and really are putting the first slice to cache.
+	Assert(slice.number > 0 || _slices.isGoodHeader());
+
+	const auto index = std::max(slice.number, 1) - 1;
+	cancelLoadInRange(index * kInSlice, (index + 1) * kInSlice);
+	putToCache(std::move(slice));
+}
+
+void Reader::unloadSlicesOverLimit() {
+	// Inactive readers don't fill anymore, so they can't unload slices
+	// on their own when the active ones need the memory budget.
+	if (_streamingError) {
+		return;
+	}
+	while (_slices.unloadUnusedRequired(true)) {
+		putUnloadedToCache(_slices.serializeAndUnloadUnused(true));
+	}
+	_slices.unloadRequestHandled();
 }
 
 int64 Reader::size() const {
@@ -1225,6 +1321,12 @@ bool Reader::fullInCache() const {
 	return _slices.fullInCache();
 }
 
+Reader::Statistics Reader::statistics() const {
+	auto result = _statistics;
+	result.memoryPeak = _slices.memoryPeak();
+	return result;
+}
+
 Reader::FillState Reader::fill(
 		int64 offset,
 		bytes::span buffer,
@@ -1246,6 +1348,19 @@ Reader::FillState Reader::fill(
 	};
 	const auto done = [&] {
 		clearWaiting();
+		++_statistics.fills;
+		_statistics.bytesFilled += buffer.size();
+		if (_fillWaitStarted) {
+			const auto waited = crl::now() - base::take(_fillWaitStarted);
+			++_statistics.fillsWaited;
+			_statistics.fillWaitTotal += waited;
+			_statistics.fillWaitMax = std::max(
+				_statistics.fillWaitMax,
+				waited);
+		}
+		if (base::take(_fillWaitedRemote)) {
+			++_statistics.fillsWaitedRemote;
+		}
 		return FillState::Success;
 	};
 	const auto failed = [&] {
@@ -1266,6 +1381,12 @@ Reader::FillState Reader::fill(
 			return done();
 		}
 		startWaiting();
+		if (!_fillWaitStarted) {
+			_fillWaitStarted = crl::now();
+		}
+		if (lastResult == FillState::WaitingRemote) {
+			_fillWaitedRemote = true;
+		}
 	} while (checkForSomethingMoreReceived());
 
 	return _streamingError ? failed() : lastResult;
@@ -1284,15 +1405,7 @@ Reader::FillState Reader::fillFromSlices(uint32 offset, bytes::span buffer) {
 		readFromCache(sliceNumber);
 	}
 
-	if (_cacheHelper && result.toCache.number >= 0) {
-		// If we put to cache the header (number == 0) that means we're in
-		// HeaderMode::Good and really are putting the first slice to cache.
-		Assert(result.toCache.number > 0 || _slices.isGoodHeader());
-
-		const auto index = std::max(result.toCache.number, 1) - 1;
-		cancelLoadInRange(index * kInSlice, (index + 1) * kInSlice);
-		putToCache(std::move(result.toCache));
-	}
+	putUnloadedToCache(std::move(result.toCache));
 	auto checkPriority = true;
 	for (const auto offset : result.offsetsFromLoader.values()) {
 		if (checkPriority) {
@@ -1371,6 +1484,8 @@ bool Reader::processLoadedParts() {
 		} else if (!_loadingOffsets.remove(part.offset)) {
 			continue;
 		}
+		_statistics.bytesLoaded += part.bytes.size();
+		_partsReceived[part.offset / kPartSize] = true;
 		_slices.processPart(
 			part.offset,
 			std::move(part.bytes));
@@ -1386,6 +1501,11 @@ bool Reader::checkForSomethingMoreReceived() {
 
 void Reader::loadAtOffset(uint32 offset) {
 	if (_loadingOffsets.add(offset)) {
+		if (_partsReceived[offset / kPartSize]) {
+			_statistics.bytesLoadedAgain += std::min(
+				kPartSize,
+				size() - offset);
+		}
 		_loader->load(offset);
 	}
 }
@@ -1407,7 +1527,40 @@ void Reader::finalizeCache() {
 	_cache->sync();
 }
 
+void Reader::logStatistics() const {
+	const auto stats = statistics();
+	if (!stats.fills) {
+		return;
+	}
+	DEBUG_LOG(("Streaming Info: Reader %1 bytes, "
+		"fills: %2 (%3 waited, hit rate %4%, total %5 ms, max %6 ms), "
+		"filled: %7, loaded: %8 (%9 again), "
+		"cache slices: %10 read, %11 written, memory peak: %12."
+		).arg(size()
+		).arg(stats.fills
+		).arg(stats.fillsWaited
+		).arg(qRound(stats.hitRate() * 100)
+		).arg(stats.fillWaitTotal
+		).arg(stats.fillWaitMax
+		).arg(stats.bytesFilled
+		).arg(stats.bytesLoaded
+		).arg(stats.bytesLoadedAgain
+		).arg(stats.slicesReadFromCache
+		).arg(stats.slicesPutToCache
+		).arg(stats.memoryPeak));
+
+	const auto memory = SlicesMemory::Statistics();
+	DEBUG_LOG(("Streaming Info: Slices memory %1 / %2 bytes, "
+		"peak: %3, readers: %4, unloads: %5."
+		).arg(memory.used
+		).arg(memory.limit
+		).arg(memory.peak
+		).arg(memory.readers
+		).arg(memory.unloads));
+}
+
 Reader::~Reader() {
+	logStatistics();
 	finalizeCache();
 }
 
@@ -8,6 +8,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #pragma once
 
 #include "media/streaming/media_streaming_loader.h"
+#include "media/streaming/media_streaming_slices_memory.h"
 #include "base/bytes.h"
 #include "base/weak_ptr.h"
 #include "base/thread_safe_wrap.h"
@@ -38,6 +39,25 @@ public:
 		WaitingRemote,
 		Failed,
 	};
+	struct Statistics {
+		int fills = 0;
+		int fillsWaited = 0;
+		int fillsWaitedRemote = 0;
+		crl::time fillWaitTotal = 0;
+		crl::time fillWaitMax = 0;
+		int64 bytesFilled = 0;
+		int64 bytesLoaded = 0;
+		int64 bytesLoadedAgain = 0;
+		int slicesReadFromCache = 0;
+		int slicesPutToCache = 0;
+		int64 memoryPeak = 0;
+
+		// Part of the fills served from memory or the cache database,
+		// without waiting for the loader.
+		[[nodiscard]] float64 hitRate() const {
+			return fills ? (1. - fillsWaitedRemote / float64(fills)) : 0.;
+		}
+	};
 
 	// Main thread.
 	explicit Reader(
@@ -59,6 +79,7 @@ public:
 	void headerDone();
 	[[nodiscard]] int headerSize() const;
 	[[nodiscard]] bool fullInCache() const;
+	[[nodiscard]] Statistics statistics() const;
 
 	// Thread safe.
 	void startSleep(not_null<crl::semaphore*> wake);
@@ -146,7 +167,7 @@ private:
 
 	class Slices {
 	public:
-		Slices(uint32 size, bool useCache);
+		Slices(uint32 size, bool useCache, Fn<void()> requestUnload);
 
 		void headerDone(bool fromCache);
 		[[nodiscard]] int headerSize() const;
@@ -165,10 +186,19 @@ private:
 
 		[[nodiscard]] FillResult fill(uint32 offset, bytes::span buffer);
 		[[nodiscard]] SerializedSlice unloadToCache();
+		// Idle readers may unload all the slices, not only the old ones.
+		[[nodiscard]] bool unloadUnusedRequired(bool idle = false) const;
+		[[nodiscard]] SerializedSlice serializeAndUnloadUnused(
+			bool idle = false);
+		void unloadRequestHandled();
 
 		[[nodiscard]] QByteArray partForDownloader(uint32 offset) const;
 		[[nodiscard]] bool readCacheForDownloaderRequired(uint32 offset);
 
+		[[nodiscard]] int64 memoryUsage() const;
+		[[nodiscard]] int64 memoryPeak() const;
+		void setMemoryPriority(int priority);
+
 	private:
 		enum class HeaderMode {
 			Unknown,
@@ -182,7 +212,6 @@ private:
 		[[nodiscard]] int maxSliceSize(int sliceNumber) const;
 		[[nodiscard]] SerializedSlice serializeAndUnloadSlice(
 			int sliceNumber);
-		[[nodiscard]] SerializedSlice serializeAndUnloadUnused();
 		[[nodiscard]] QByteArray serializeComplexSlice(
 			const Slice &slice) const;
 		[[nodiscard]] QByteArray serializeAndUnloadFirstSliceNoHeader();
@@ -191,7 +220,8 @@ private:
 		[[nodiscard]] FillResult fillFromHeader(
 			uint32 offset,
 			bytes::span buffer);
-		void unloadSlice(Slice &slice) const;
+		void unloadSlice(Slice &slice);
+		void changeMemoryUsage(int64 delta);
 		void checkSliceFullLoaded(int sliceNumber);
 		[[nodiscard]] bool checkFullInCache() const;
 
@@ -201,6 +231,9 @@ private:
 		uint32 _size = 0;
 		HeaderMode _headerMode = HeaderMode::Unknown;
 		bool _fullInCache = false;
+		int64 _memoryUsage = 0;
+		int64 _memoryPeak = 0;
+		SlicesMemory _memory;
 
 	};
 
@@ -210,6 +243,8 @@ private:
 	[[nodiscard]] bool readFromCacheForDownloader(int sliceNumber);
 	bool processCacheResults();
 	void putToCache(SerializedSlice &&data);
+	void putUnloadedToCache(SerializedSlice &&data);
+	void unloadSlicesOverLimit();
 
 	void cancelLoadInRange(uint32 from, uint32 till);
 	void loadAtOffset(uint32 offset);
@@ -221,6 +256,7 @@ private:
 	FillState fillFromSlices(uint32 offset, bytes::span buffer);
 
 	void finalizeCache();
+	void logStatistics() const;
 
 	void processDownloaderRequests();
 	void checkCacheResultsForDownloader();
@@ -254,6 +290,12 @@ private:
 	// Even if streaming had failed, the Reader can work for the downloader.
 	std::optional<Error> _streamingError;
 
+	// Streaming thread, read on main thread after streaming is stopped.
+	Statistics _statistics;
+	std::vector<bool> _partsReceived;
+	crl::time _fillWaitStarted = 0;
+	bool _fillWaitedRemote = false;
+
 	// In case streaming is active both main and streaming threads have work.
 	// In case only downloader is active, all work is done on main thread.
 
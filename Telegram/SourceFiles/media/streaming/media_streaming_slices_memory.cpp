@@ -0,0 +1,161 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#include "media/streaming/media_streaming_slices_memory.h"
+
+#include <QtCore/QMutex>
+
+namespace Media {
+namespace Streaming {
+namespace {
+
+constexpr auto kDefaultLimit = int64(64 * 1024 * 1024);
+
+struct Pool {
+	QMutex mutex;
+	std::vector<not_null<const SlicesMemory*>> readers;
+	std::atomic<int64> limit = kDefaultLimit;
+	std::atomic<int64> used = 0;
+	std::atomic<int64> peak = 0;
+	std::atomic<int> unloads = 0;
+};
+
+[[nodiscard]] Pool &Instance() {
+	static auto result = Pool();
+	return result;
+}
+
+} // namespace
+
+SlicesMemory::SlicesMemory(Fn<void()> requestUnload)
+: _requestUnload(std::move(requestUnload)) {
+	Expects(_requestUnload != nullptr);
+
+	auto &pool = Instance();
+	QMutexLocker lock(&pool.mutex);
+	pool.readers.push_back(this);
+}
+
+SlicesMemory::~SlicesMemory() {
+	changeUsage(-_usage.load(std::memory_order_relaxed));
+
+	auto &pool = Instance();
+	QMutexLocker lock(&pool.mutex);
+	pool.readers.erase(
+		ranges::remove(pool.readers, not_null<const SlicesMemory*>(this)),
+		end(pool.readers));
+}
+
+void SlicesMemory::SetLimit(int64 bytes) {
+	Expects(bytes > 0);
+
+	Instance().limit.store(bytes, std::memory_order_relaxed);
+}
+
+int64 SlicesMemory::DefaultLimit() {
+	return kDefaultLimit;
+}
+
+SlicesMemoryStatistics SlicesMemory::Statistics() {
+	auto &pool = Instance();
+	auto result = SlicesMemoryStatistics{
+		.limit = pool.limit.load(std::memory_order_relaxed),
+		.used = pool.used.load(std::memory_order_relaxed),
+		.peak = pool.peak.load(std::memory_order_relaxed),
+		.unloads = pool.unloads.load(std::memory_order_relaxed),
+	};
+	QMutexLocker lock(&pool.mutex);
+	result.readers = int(pool.readers.size());
+	return result;
+}
+
+void SlicesMemory::setPriority(int priority) {
+	_priority.store(priority, std::memory_order_relaxed);
+}
+
+void SlicesMemory::changeUsage(int64 delta) {
+	if (!delta) {
+		return;
+	}
+	_usage.fetch_add(delta, std::memory_order_relaxed);
+
+	auto &pool = Instance();
+	const auto now = pool.used.fetch_add(delta, std::memory_order_relaxed)
+		+ delta;
+	auto peak = pool.peak.load(std::memory_order_relaxed);
+	while (now > peak
+		&& !pool.peak.compare_exchange_weak(
+			peak,
+			now,
+			std::memory_order_relaxed)) {
+	}
+	const auto limit = pool.limit.load(std::memory_order_relaxed);
+	if (delta > 0 && now > limit) {
+		requestUnloads(now - limit);
+	}
+}
+
+void SlicesMemory::requestUnloads(int64 excess) const {
+	auto &pool = Instance();
+	const auto priority = _priority.load(std::memory_order_relaxed);
+	const auto readerPriority = [](not_null<const SlicesMemory*> reader) {
+		return reader->_priority.load(std::memory_order_relaxed);
+	};
+
+	QMutexLocker lock(&pool.mutex);
+	auto readers = pool.readers;
+	ranges::stable_sort(readers, ranges::less(), readerPriority);
+	for (const auto reader : readers) {
+		if (excess <= 0 || readerPriority(reader) > priority) {
+			break;
+		} else if (reader == this) {
+			continue;
+		}
+		const auto usage = reader->_usage.load(std::memory_order_relaxed);
+		if (!usage) {
+			continue;
+		}
+		excess -= usage;
+		if (!reader->_unloadRequested.exchange(true)) {
+			reader->_requestUnload();
+		}
+	}
+}
+
+bool SlicesMemory::shouldUnload() const {
+	auto &pool = Instance();
+	const auto limit = pool.limit.load(std::memory_order_relaxed);
+	if (pool.used.load(std::memory_order_relaxed) <= limit) {
+		_unloadRequested.store(false, std::memory_order_relaxed);
+		return false;
+	} else if (_unloadRequested.load(std::memory_order_relaxed)) {
+		return true;
+	}
+
+	// Readers with higher priority have the first claim on the budget,
+	// so we unload only if they together with us don't fit in it.
+	const auto priority = _priority.load(std::memory_order_relaxed);
+	auto claimed = int64();
+	QMutexLocker lock(&pool.mutex);
+	for (const auto reader : pool.readers) {
+		if (reader->_priority.load(std::memory_order_relaxed) >= priority) {
+			claimed += reader->_usage.load(std::memory_order_relaxed);
+		}
+	}
+	return (claimed > limit);
+}
+
+void SlicesMemory::unloaded() {
+	Instance().unloads.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SlicesMemory::unloadRequestHandled() {
+	_unloadRequested.store(false, std::memory_order_relaxed);
+}
+
+} // namespace Streaming
+} // namespace Media
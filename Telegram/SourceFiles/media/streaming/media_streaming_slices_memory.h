@@ -0,0 +1,61 @@
+/*
+This file is part of exteraGram Desktop,
+the unofficial app based on Telegram Desktop.
+
+For license and copyright information please follow this link:
+https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
+*/
+#pragma once
+
+namespace Media {
+namespace Streaming {
+
+struct SlicesMemoryStatistics {
+	int64 limit = 0;
+	int64 used = 0;
+	int64 peak = 0;
+	int readers = 0;
+	int unloads = 0;
+};
+
+// Process-wide budget for the slices kept in memory by all readers.
+//
+// Each Reader registers one SlicesMemory and reports the bytes it holds.
+// When the total goes over the limit the readers with the lowest priority
+// are asked to unload their least recently used slices first. Idle readers
+// don't add slices and never check the limit themselves, so they receive
+// the requestUnload callback, which may be called from any thread.
+class SlicesMemory final {
+public:
+	// Main thread.
+	explicit SlicesMemory(Fn<void()> requestUnload);
+	SlicesMemory(const SlicesMemory &other) = delete;
+	SlicesMemory &operator=(const SlicesMemory &other) = delete;
+	~SlicesMemory();
+
+	// Set from the app settings, the default is used in tools.
+	static void SetLimit(int64 bytes);
+	[[nodiscard]] static int64 DefaultLimit();
+
+	// Thread safe.
+	[[nodiscard]] static SlicesMemoryStatistics Statistics();
+	void setPriority(int priority);
+
+	// Single thread.
+	void changeUsage(int64 delta);
+	[[nodiscard]] bool shouldUnload() const;
+	void unloaded();
+	void unloadRequestHandled();
+
+private:
+	void requestUnloads(int64 excess) const;
+
+	const Fn<void()> _requestUnload;
+	std::atomic<int> _priority = 0;
+	std::atomic<int64> _usage = 0;
+	mutable std::atomic<bool> _unloadRequested = false;
+
+};
+
+} // namespace Streaming
+} // namespace Media
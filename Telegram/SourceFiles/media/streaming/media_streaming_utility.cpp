@@ -346,16 +346,18 @@ void PaintFrameContent(
 	PaintFrameInner(p, target, original, deAlpha, rotation);
 }
 
-void ApplyFrameRounding(QImage &storage, const FrameRequest &request) {
-	if (!request.mask.isNull()) {
-		auto p = QPainter(&storage);
-		p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-		p.drawImage(
-			QRect(QPoint(), storage.size() / storage.devicePixelRatio()),
-			request.mask);
-	} else if (!request.rounding.empty()) {
-		storage = Images::Round(std::move(storage), request.rounding);
+void ApplyFrameMask(
+		QPainter &p,
+		const QImage &storage,
+		const FrameRequest &request) {
+	if (request.mask.isNull()) {
+		return;
 	}
+	p.resetTransform();
+	p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+	p.drawImage(
+		QRect(QPoint(), storage.size() / storage.devicePixelRatio()),
+		request.mask);
 }
 
 ExpandDecision DecideFrameResize(
@@ -428,11 +430,16 @@ QImage PrepareByRequest(
 		storage.fill(Qt::transparent);
 	}
 
+	// Masking only multiplies the frame pixels, so it is done by the
+	// same painter instead of a separate full pass.
 	QPainter p(&storage);
 	PaintFrameContent(p, original, hasAlpha, aspect, rotation, request);
+	ApplyFrameMask(p, storage, request);
 	p.end();
 
-	ApplyFrameRounding(storage, request);
+	if (request.mask.isNull() && !request.rounding.empty()) {
+		storage = Images::Round(std::move(storage), request.rounding);
+	}
 	if (request.colored.alpha() != 0) {
 		storage = Images::Colored(std::move(storage), request.colored);
 	}
@@ -301,7 +301,7 @@ void GroupThumbs::Thumb::validateImage() {
 			Qt::IgnoreAspectRatio,
 			Qt::SmoothTransformation));
 	} else {
-		_full = _image->pixNoCache(pixSize * style::DevicePixelRatio());
+		_full = _image->pixShared(pixSize * style::DevicePixelRatio());
 	}
 	_fullWidth = std::min(
 		wantedPixSize().width(),
@@ -20,6 +20,9 @@ namespace {
 
 std::atomic<int> GlobalConnectionCounter/* = 0*/;
 
+constexpr auto kReceiveBuffersPoolSize = 2;
+constexpr auto kReceiveBufferMaxKeptSize = 2 * 1024 * 1024;
+
 } // namespace
 
 ConnectionPointer::ConnectionPointer() = default;
@@ -104,6 +107,39 @@ mtpBuffer AbstractConnection::prepareSecurePacket(
 	return result;
 }
 
+void AbstractConnection::releaseReceived(mtpBuffer &&buffer) {
+	const auto capacity = int64(buffer.capacity()) * int64(sizeof(mtpPrime));
+	if (int(_receiveBuffers.size()) >= kReceiveBuffersPoolSize
+		|| !capacity
+		|| capacity > kReceiveBufferMaxKeptSize) {
+		return;
+	}
+	buffer.clear();
+	_receiveBuffers.push_back(std::move(buffer));
+}
+
+mtpBuffer AbstractConnection::takeReceiveBuffer(int size) {
+	if (_receiveBuffers.empty()) {
+		return mtpBuffer(size);
+	}
+	// Take the smallest buffer that fits without reallocation.
+	auto best = end(_receiveBuffers);
+	for (auto i = begin(_receiveBuffers); i != end(_receiveBuffers); ++i) {
+		if (i->capacity() >= size
+			&& (best == end(_receiveBuffers)
+				|| best->capacity() > i->capacity())) {
+			best = i;
+		}
+	}
+	if (best == end(_receiveBuffers)) {
+		best = begin(_receiveBuffers);
+	}
+	auto result = std::move(*best);
+	_receiveBuffers.erase(best);
+	result.resize(size);
+	return result;
+}
+
 gsl::span<const mtpPrime> AbstractConnection::parseNotSecureResponse(
 		const mtpBuffer &buffer) const {
 	const auto answer = buffer.data();
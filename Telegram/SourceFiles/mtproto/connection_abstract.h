@@ -114,6 +114,10 @@ public:
 		return _receivedQueue;
 	}
 
+	// Handled buffers from received() may be given back here,
+	// so that the next packets reuse their memory.
+	virtual void releaseReceived(mtpBuffer &&buffer);
+
 	template <typename Request>
 	[[nodiscard]] mtpBuffer prepareNotSecurePacket(
 		const Request &request,
@@ -160,9 +164,12 @@ protected:
 	[[nodiscard]] std::optional<MTPResPQ> readPQFakeReply(
 		const mtpBuffer &buffer) const;
 
+	[[nodiscard]] mtpBuffer takeReceiveBuffer(int size);
+
 private:
 	[[nodiscard]] uint32 extendedNotSecurePadding() const;
 
+	std::vector<mtpBuffer> _receiveBuffers;
 	uint64 _sentEncryptedWithKeyId = 0;
 
 };
@@ -194,6 +194,12 @@ void ResolvingConnection::sendData(mtpBuffer &&buffer) {
 	_child->sendData(std::move(buffer));
 }
 
+void ResolvingConnection::releaseReceived(mtpBuffer &&buffer) {
+	if (_child) {
+		_child->releaseReceived(std::move(buffer));
+	}
+}
+
 void ResolvingConnection::disconnectFromServer() {
 	_address = QString();
 	_port = 0;
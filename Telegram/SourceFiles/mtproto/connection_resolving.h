@@ -27,6 +27,7 @@ public:
 	crl::time pingTime() const override;
 	crl::time fullConnectTimeout() const override;
 	void sendData(mtpBuffer &&buffer) override;
+	void releaseReceived(mtpBuffer &&buffer) override;
 	void disconnectFromServer() override;
 	void connectToServer(
 		const QString &address,
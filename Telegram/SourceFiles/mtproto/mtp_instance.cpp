@@ -21,6 +21,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "apiwrap.h"
 #include "core/application.h"
 #include "core/core_settings.h"
+#include "core/core_tracing.h"
 #include "lang/lang_instance.h"
 #include "lang/lang_cloud_manager.h"
 #include "base/unixtime.h"
@@ -1005,6 +1006,7 @@ void Instance::Private::sendRequest(
 
 	request->requestId = requestId;
 	storeRequest(requestId, request, std::move(callbacks));
+	TRACE_ASYNC_BEGIN("MTP::Request", requestId);
 
 	const auto toMainDc = (shiftedDcId == 0);
 	const auto realShiftedDcId = session->getDcWithShift();
@@ -1029,6 +1031,7 @@ void Instance::Private::registerRequest(
 
 void Instance::Private::unregisterRequest(mtpRequestId requestId) {
 	DEBUG_LOG(("MTP Info: unregistering request %1.").arg(requestId));
+	TRACE_ASYNC_END("MTP::Request", requestId);
 
 	_requestsDelays.erase(requestId);
 
@@ -1115,6 +1118,8 @@ bool Instance::Private::hasCallback(mtpRequestId requestId) const {
 }
 
 void Instance::Private::processCallback(const Response &response) {
+	TRACE_SCOPE("MTP::Instance::processCallback");
+
 	const auto requestId = response.requestId;
 	ResponseHandler handler;
 	{
@@ -50,6 +50,13 @@ constexpr auto kRequestConfigTimeout = 8 * crl::time(1000);
 // Don't try to handle messages larger than this size.
 constexpr auto kMaxMessageLength = 16 * 1024 * 1024;
 
+// Trust the unpacked size from the gzip trailer up to this size.
+constexpr auto kMaxUnpackedSizeHint = 256 * 1024 * 1024;
+constexpr auto kMaxDeflateRatio = 1032;
+
+// Log unpacking of gzip_packed responses larger than this size.
+constexpr auto kLogUnpackedSize = 1024 * 1024;
+
 // How much time passed from send till we resend request or check its state.
 constexpr auto kCheckSentRequestTimeout = 10 * crl::time(1000);
 
@@ -123,6 +130,45 @@ void WrapInvokeAfter(
 	}
 }
 
+[[nodiscard]] bytes::const_span ReadSerializedBytes(
+		const mtpPrime *from,
+		const mtpPrime *end) {
+	if (from >= end) {
+		return {};
+	}
+	const auto available = (end - from) * kIntSize;
+	const auto data = reinterpret_cast<const uchar*>(from);
+	const auto large = (data[0] == 254);
+	const auto offset = large ? 4 : 1;
+	const auto length = large
+		? (data[1] | (data[2] << 8) | (data[3] << 16))
+		: int(data[0]);
+	if (data[0] == 255 || offset + length > available) {
+		return {};
+	}
+	return bytes::const_span(
+		reinterpret_cast<const bytes::type*>(data + offset),
+		length);
+}
+
+// The last four bytes of gzip hold the unpacked size modulo 2^32.
+[[nodiscard]] int UnpackedSizeHint(bytes::const_span packed) {
+	if (packed.size() < 18) {
+		return 0;
+	}
+	const auto trailer = reinterpret_cast<const uchar*>(
+		packed.data() + packed.size() - 4);
+	const auto result = uint32(trailer[0])
+		| (uint32(trailer[1]) << 8)
+		| (uint32(trailer[2]) << 16)
+		| (uint32(trailer[3]) << 24);
+	return (result > 0
+		&& result <= uint32(kMaxUnpackedSizeHint)
+		&& result <= uint64(packed.size()) * kMaxDeflateRatio)
+		? int(result)
+		: 0;
+}
+
 [[nodiscard]] bool ConstTimeIsDifferent(
 		const void *a,
 		const void *b,
@@ -138,6 +184,20 @@ void WrapInvokeAfter(
 
 } // namespace
 
+struct SessionPrivate::Inflater {
+	Inflater() = default;
+	Inflater(const Inflater &other) = delete;
+	Inflater &operator=(const Inflater &other) = delete;
+	~Inflater() {
+		if (initialized) {
+			inflateEnd(&stream);
+		}
+	}
+
+	z_stream stream = z_stream();
+	bool initialized = false;
+};
+
 SessionPrivate::SessionPrivate(
 	not_null<Instance*> instance,
 	not_null<QThread*> thread,
@@ -1247,7 +1307,7 @@ void SessionPrivate::handleReceived() {
 		constexpr auto kMinimalEncryptedIntsCount = kEncryptedHeaderIntsCount + 4U; // + 1 data + 3 padding
 		constexpr auto kMinimalIntsCount = kExternalHeaderIntsCount + kMinimalEncryptedIntsCount;
 		auto intsCount = uint32(intsBuffer.size());
-		auto ints = intsBuffer.constData();
+		auto ints = intsBuffer.data();
 		if ((intsCount < kMinimalIntsCount) || (intsCount > kMaxMessageLength / kIntSize)) {
 			LOG(("TCP Error: bad message received, len %1").arg(intsCount * kIntSize));
 			return restart();
@@ -1263,12 +1323,12 @@ void SessionPrivate::handleReceived() {
 		auto encryptedInts = ints + kExternalHeaderIntsCount;
 		auto encryptedIntsCount = (intsCount - kExternalHeaderIntsCount) & ~0x03U;
 		auto encryptedBytesCount = encryptedIntsCount * kIntSize;
-		auto decryptedBuffer = QByteArray(encryptedBytesCount, Qt::Uninitialized);
 		auto msgKey = *(MTPint128*)(ints + 2);
 
-		aesIgeDecrypt(encryptedInts, decryptedBuffer.data(), encryptedBytesCount, _encryptionKey, msgKey);
+		// Decrypt in place, the encrypted bytes are not needed afterwards.
+		aesIgeDecrypt(encryptedInts, encryptedInts, encryptedBytesCount, _encryptionKey, msgKey);
 
-		auto decryptedInts = reinterpret_cast<const mtpPrime*>(decryptedBuffer.constData());
+		const auto decryptedInts = encryptedInts;
 		auto serverSalt = *(uint64*)&decryptedInts[0];
 		auto session = *(uint64*)&decryptedInts[2];
 		auto msgId = *(uint64*)&decryptedInts[4];
@@ -1372,6 +1432,7 @@ void SessionPrivate::handleReceived() {
 			res = HandleResult::ResetSession;
 		}
 		_receivedMessageIds.shrink();
+		_connection->releaseReceived(std::move(intsBuffer));
 
 		// send acks
 		if (const auto toAckSize = _ackRequestData.size()) {
@@ -1971,54 +2032,90 @@ SessionPrivate::HandleResult SessionPrivate::handleBindResponse(
 	Unexpected("Result of BoundKeyCreator::handleBindResponse.");
 }
 
-mtpBuffer SessionPrivate::ungzip(const mtpPrime *from, const mtpPrime *end) const {
-	mtpBuffer result; // * 4 because of mtpPrime type
-	result.resize(0);
-
-	MTPstring packed;
-	if (!packed.read(from, end)) { // read packed string as serialized mtp string type
+mtpBuffer SessionPrivate::ungzip(const mtpPrime *from, const mtpPrime *end) {
+	const auto packed = ReadSerializedBytes(from, end);
+	if (packed.empty()) {
 		LOG(("RPC Error: could not read gziped bytes."));
-		return result;
-	}
-	uint32 packedLen = packed.v.size(), unpackedChunk = packedLen;
-
-	z_stream stream;
-	stream.zalloc = 0;
-	stream.zfree = 0;
-	stream.opaque = 0;
-	stream.avail_in = 0;
-	stream.next_in = 0;
-	int res = inflateInit2(&stream, 16 + MAX_WBITS);
-	if (res != Z_OK) {
-		LOG(("RPC Error: could not init zlib stream, code: %1").arg(res));
-		return result;
+		return mtpBuffer();
 	}
-	stream.avail_in = packedLen;
-	stream.next_in = reinterpret_cast<Bytef*>(packed.v.data());
+	const auto started = crl::now();
 
-	stream.avail_out = 0;
-	while (!stream.avail_out) {
-		result.resize(result.size() + unpackedChunk);
-		stream.avail_out = unpackedChunk * sizeof(mtpPrime);
-		stream.next_out = (Bytef*)&result[result.size() - unpackedChunk];
-		int res = inflate(&stream, Z_NO_FLUSH);
-		if (res != Z_OK && res != Z_STREAM_END) {
-			inflateEnd(&stream);
+	// The zlib state with its window is kept between the calls.
+	if (!_inflater) {
+		_inflater = std::make_unique<Inflater>();
+	}
+	auto &stream = _inflater->stream;
+	const auto init = _inflater->initialized
+		? inflateReset(&stream)
+		: inflateInit2(&stream, 16 + MAX_WBITS);
+	if (init != Z_OK) {
+		LOG(("RPC Error: could not init zlib stream, code: %1").arg(init));
+		_inflater = nullptr;
+		return mtpBuffer();
+	}
+	_inflater->initialized = true;
+
+	// With a valid size hint the result is allocated only once,
+	// otherwise it grows geometrically.
+	const auto hint = UnpackedSizeHint(packed);
+	auto result = mtpBuffer((hint > 0)
+		? ((hint + kIntSize - 1) / kIntSize)
+		: (int(packed.size()) + kIntSize - 1) / kIntSize * 4);
+	stream.avail_in = uInt(packed.size());
+	stream.next_in = reinterpret_cast<Bytef*>(
+		const_cast<bytes::type*>(packed.data()));
+	stream.avail_out = uInt(result.size() * kIntSize);
+	stream.next_out = reinterpret_cast<Bytef*>(result.data());
+	while (true) {
+		const auto res = inflate(&stream, Z_NO_FLUSH);
+		if (res == Z_STREAM_END || (!stream.avail_in && stream.avail_out)) {
+			break;
+		} else if (res != Z_OK && res != Z_BUF_ERROR) {
 			LOG(("RPC Error: could not unpack gziped data, code: %1").arg(res));
-			DEBUG_LOG(("RPC Error: bad gzip: %1").arg(Logs::mb(packed.v.constData(), packedLen).str()));
+			DEBUG_LOG(("RPC Error: bad gzip: %1").arg(Logs::mb(packed.data(), packed.size()).str()));
 			return mtpBuffer();
-		}
-	}
-	if (stream.avail_out & 0x03) {
-		uint32 badSize = result.size() * sizeof(mtpPrime) - stream.avail_out;
-		LOG(("RPC Error: bad length of unpacked data %1").arg(badSize));
-		DEBUG_LOG(("RPC Error: bad unpacked data %1").arg(Logs::mb(result.data(), badSize).str()));
+		} else if (!stream.avail_out) {
+			const auto written = int(stream.total_out);
+			result.resize(result.size() * 2);
+			stream.avail_out = uInt(result.size() * kIntSize - written);
+			stream.next_out = reinterpret_cast<Bytef*>(result.data())
+				+ written;
+		}
+	}
+	const auto unpacked = int64(stream.total_out);
+	if (unpacked & 0x03) {
+		LOG(("RPC Error: bad length of unpacked data %1").arg(unpacked));
+		DEBUG_LOG(("RPC Error: bad unpacked data %1").arg(Logs::mb(result.data(), unpacked).str()));
 		return mtpBuffer();
 	}
-	result.resize(result.size() - (stream.avail_out >> 2));
-	inflateEnd(&stream);
+	result.resize(unpacked / kIntSize);
 	if (!result.size()) {
 		LOG(("RPC Error: bad length of unpacked data 0"));
+		return result;
+	}
+
+	auto &statistics = _ungzipStatistics;
+	++statistics.count;
+	statistics.packedBytes += packed.size();
+	statistics.unpackedBytes += unpacked;
+	if (hint != unpacked) {
+		++statistics.reallocated;
+	}
+	if (statistics.maxUnpackedBytes < unpacked) {
+		statistics.maxUnpackedBytes = unpacked;
+	}
+	if (unpacked >= kLogUnpackedSize) {
+		DEBUG_LOG(("RPC Info: unpacked %1 bytes to %2 bytes in %3 ms, "
+			"session total: %4 responses, %5 bytes to %6 bytes, "
+			"largest %7 bytes, %8 without a correct size hint."
+			).arg(packed.size()
+			).arg(unpacked
+			).arg(crl::now() - started
+			).arg(statistics.count
+			).arg(statistics.packedBytes
+			).arg(statistics.unpackedBytes
+			).arg(statistics.maxUnpackedBytes
+			).arg(statistics.reallocated));
 	}
 	return result;
 }
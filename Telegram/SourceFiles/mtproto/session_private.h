@@ -133,7 +133,7 @@ private:
 	[[nodiscard]] HandleResult handleBindResponse(
 		mtpMsgId requestMsgId,
 		const mtpBuffer &response);
-	mtpBuffer ungzip(const mtpPrime *from, const mtpPrime *end) const;
+	mtpBuffer ungzip(const mtpPrime *from, const mtpPrime *end);
 	void handleMsgsStates(const QVector<MTPlong> &ids, const QByteArray &states);
 
 	// _sessionDataMutex must be locked for read.
@@ -238,6 +238,17 @@ private:
 	mtpMsgId _bindMsgId = 0;
 	crl::time _bindMessageSent = 0;
 
+	struct Inflater;
+	struct UngzipStatistics {
+		int64 count = 0;
+		int64 packedBytes = 0;
+		int64 unpackedBytes = 0;
+		int64 maxUnpackedBytes = 0;
+		int64 reallocated = 0;
+	};
+	std::unique_ptr<Inflater> _inflater;
+	UngzipStatistics _ungzipStatistics;
+
 };
 
 } // namespace details
@@ -1190,7 +1190,7 @@ void Document::paint(Painter &p, const QRect &clip, TextSelection selection, con
 								? Images::Option()
 								: Images::Option::Blur);
 						const auto image = thumbnail ? thumbnail : blurred;
-						_thumb = image->pixNoCache(
+						_thumb = image->pixShared(
 							_thumbw * style::DevicePixelRatio(),
 							{
 								.options = options,
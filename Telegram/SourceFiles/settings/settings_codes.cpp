@@ -19,6 +19,8 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "lang/lang_cloud_manager.h"
 #include "lang/lang_instance.h"
 #include "core/application.h"
+#include "core/core_memory_usage.h"
+#include "core/core_tracing.h"
 #include "mtproto/mtp_instance.h"
 #include "mtproto/mtproto_dc_options.h"
 #include "core/file_utilities.h"
@@ -27,6 +29,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "window/themes/window_theme_editor.h"
 #include "window/window_session_controller.h"
 #include "media/audio/media_audio_track.h"
+#include "media/clip/media_clip_reader.h"
 #include "settings/settings_common.h"
 #include "settings/settings_folders.h"
 #include "api/api_updates.h"
@@ -162,6 +165,39 @@ auto GenerateCodes() {
 			window->showSettings(Settings::Folders::Id());
 		}
 	});
+	codes.emplace(u"memoryusage"_q, [](SessionController *window) {
+		Ui::show(Ui::MakeInformBox(Core::App().memoryUsage().report()));
+	});
+	codes.emplace(u"memorytrim"_q, [](SessionController *window) {
+		Core::App().memoryUsage().trim();
+		Ui::Toast::Show("Caches trimmed.");
+	});
+	codes.emplace(u"gifstats"_q, [](SessionController *window) {
+		const auto stats = Media::Clip::CurrentStatistics();
+		Ui::show(Ui::MakeInformBox(u"Readers: %1, threads: %2\n"
+			"Frames decoded: %3, late: %4, dropped: %5"_q
+			).arg(stats.readers
+			).arg(stats.threads
+			).arg(stats.decoded
+			).arg(stats.late
+			).arg(stats.dropped)));
+	});
+	codes.emplace(u"tracestart"_q, [](SessionController *window) {
+		Core::Tracing::Start();
+		Ui::Toast::Show("Tracing started.");
+	});
+	codes.emplace(u"tracestop"_q, [](SessionController *window) {
+		if (!Core::Tracing::Enabled()) {
+			Ui::Toast::Show("Tracing is not started.");
+			return;
+		}
+		const auto path = cWorkingDir() + u"trace.json"_q;
+		if (Core::Tracing::Finish(path)) {
+			File::ShowInFolder(path);
+		} else {
+			Ui::Toast::Show("Could not write the trace.");
+		}
+	});
 	codes.emplace(u"registertg"_q, [](SessionController *window) {
 		Core::Application::RegisterUrlScheme();
 		Ui::Toast::Show("Forced custom scheme register.");
@@ -21,7 +21,9 @@ namespace {
 
 constexpr auto kKillSessionTimeout = 15 * crl::time(1000);
 constexpr auto kStartWaitedInSession = 4 * kDownloadPartSize;
-constexpr auto kMaxWaitedInSession = 16 * kDownloadPartSize;
+constexpr auto kMaxWaitedPartsInSession = 16;
+constexpr auto kMaxWaitedInSession = kMaxWaitedPartsInSession
+	* kMaxDownloadPartSize;
 constexpr auto kStartSessionsCount = 1;
 constexpr auto kMaxSessionsCount = 8;
 constexpr auto kMaxTrackedSessionRemoves = 64;
@@ -33,6 +35,10 @@ constexpr auto kRemoveSessionAfterTimeouts = 4;
 constexpr auto kResetDownloadPrioritiesTimeout = crl::time(200);
 constexpr auto kBadRequestDurationThreshold = 8 * crl::time(1000);
 
+// We choose a part size that is loaded in about that time.
+constexpr auto kPartLoadDuration = crl::time(500);
+constexpr auto kEstimationSmoothing = 8;
+
 // Each (session remove by timeouts) we wait for time:
 // kRetryAddSessionTimeout * max(removesCount, kMaxTrackedSessionRemoves)
 // and for successes in all remaining sessions:
@@ -110,7 +116,8 @@ void DownloadManagerMtproto::Queue::removeSession(int index) {
 }
 
 DownloadManagerMtproto::DcSessionBalanceData::DcSessionBalanceData()
-: maxWaitedAmount(kStartWaitedInSession) {
+: maxWaitedAmount(kStartWaitedInSession)
+, partSize(kDownloadPartSize) {
 }
 
 DownloadManagerMtproto::DcBalanceData::DcBalanceData()
@@ -194,9 +201,15 @@ bool DownloadManagerMtproto::trySendNextPart(MTP::DcId dcId, Queue &queue) {
 	if (bestIndex < 0) {
 		return false;
 	}
+	const auto &best = sessions[bestIndex];
+	auto maxPartSize = best.partSize;
+	while (maxPartSize > kDownloadPartSize
+		&& best.requested + maxPartSize > best.maxWaitedAmount) {
+		maxPartSize /= 2;
+	}
 	const auto onlyHighestPriority = (balanceData.totalRequested > 0);
 	if (const auto task = queue.nextTask(onlyHighestPriority)) {
-		task->loadPart(bestIndex);
+		task->loadPart(bestIndex, maxPartSize);
 		return true;
 	}
 	return false;
@@ -240,13 +253,12 @@ void DownloadManagerMtproto::requestSucceeded(
 	auto &data = dc.sessions[index];
 	const auto overloaded = (timeAtRequestStart <= dc.lastSessionRemove)
 		|| (amountAtRequestStart > data.maxWaitedAmount);
-	const auto parts = amountAtRequestStart / kDownloadPartSize;
 	const auto duration = (crl::now() - timeAtRequestStart);
-	DEBUG_LOG(("Download (%1,%2) request done, duration: %3, parts: %4%5"
+	DEBUG_LOG(("Download (%1,%2) request done, duration: %3, amount: %4%5"
 		).arg(dcId
 		).arg(index
 		).arg(duration
-		).arg(parts
+		).arg(amountAtRequestStart
 		).arg(overloaded ? " (overloaded)" : ""));
 	if (overloaded) {
 		return;
@@ -259,11 +271,16 @@ void DownloadManagerMtproto::requestSucceeded(
 		});
 		return;
 	}
-	if (amountAtRequestStart == data.maxWaitedAmount
-		&& data.maxWaitedAmount < kMaxWaitedInSession) {
+	updateEstimation(data, amountAtRequestStart, duration);
+
+	// Allow as many parts of the current size in flight as we allowed
+	// for the smallest ones, so the window follows the bandwidth.
+	const auto maxWaited = kMaxWaitedPartsInSession * data.partSize;
+	if (amountAtRequestStart + kDownloadPartSize > data.maxWaitedAmount
+		&& data.maxWaitedAmount < maxWaited) {
 		data.maxWaitedAmount = std::min(
-			data.maxWaitedAmount + kDownloadPartSize,
-			kMaxWaitedInSession);
+			data.maxWaitedAmount + data.partSize,
+			maxWaited);
 		DEBUG_LOG(("Download (%1,%2) increased max waited amount %3."
 			).arg(dcId
 			).arg(index
@@ -298,6 +315,37 @@ void DownloadManagerMtproto::requestSucceeded(
 		).arg(dc.sessions.size()));
 }
 
+void DownloadManagerMtproto::updateEstimation(
+		DcSessionBalanceData &data,
+		int amountAtRequestStart,
+		crl::time duration) {
+	// By Little's law all the amount in flight was loaded in that time.
+	const auto bandwidth = float64(amountAtRequestStart)
+		/ std::max(duration, crl::time(1));
+	if (!data.duration) {
+		data.bandwidth = bandwidth;
+		data.duration = duration;
+	} else {
+		const auto k = kEstimationSmoothing;
+		data.bandwidth = (data.bandwidth * (k - 1) + bandwidth) / k;
+		data.duration = (data.duration * (k - 1) + duration) / k;
+	}
+
+	auto partSize = kMaxDownloadPartSize;
+	const auto wanted = data.bandwidth * kPartLoadDuration;
+	while (partSize > kDownloadPartSize && partSize > wanted) {
+		partSize /= 2;
+	}
+	if (data.partSize != partSize) {
+		data.partSize = partSize;
+		DEBUG_LOG(("Download bandwidth %1 bytes/ms, duration %2, "
+			"part size changed to %3."
+			).arg(data.bandwidth
+			).arg(data.duration
+			).arg(partSize));
+	}
+}
+
 int DownloadManagerMtproto::chooseSessionIndex(MTP::DcId dcId) const {
 	const auto i = _balanceData.find(dcId);
 	Assert(i != end(_balanceData));
@@ -475,20 +523,36 @@ void DownloadMtprotoTask::refreshFileReferenceFrom(
 	}
 }
 
-void DownloadMtprotoTask::loadPart(int sessionIndex) {
-	makeRequest({ takeNextRequestOffset(), sessionIndex });
+void DownloadMtprotoTask::loadPart(int sessionIndex, int maxPartSize) {
+	const auto limit = _cdnDcId
+		? kDownloadPartSize
+		: chooseNextRequestLimit(maxPartSize);
+	makeRequest({
+		.offset = takeNextRequestOffset(limit),
+		.sessionIndex = sessionIndex,
+		.limit = limit,
+	});
+}
+
+int DownloadMtprotoTask::chooseNextRequestLimit(int maxPartSize) const {
+	return kDownloadPartSize;
 }
 
 void DownloadMtprotoTask::removeSession(int sessionIndex) {
 	struct Redirect {
 		mtpRequestId requestId = 0;
 		int64 offset = 0;
+		int limit = 0;
 	};
 	auto redirect = std::vector<Redirect>();
 	for (const auto &[requestId, requestData] : _sentRequests) {
 		if (requestData.sessionIndex == sessionIndex) {
 			redirect.reserve(_sentRequests.size());
-			redirect.push_back({ requestId, requestData.offset });
+			redirect.push_back({
+				requestId,
+				requestData.offset,
+				requestData.limit,
+			});
 		}
 	}
 	for (auto &[requestData, bytes] : _cdnUncheckedParts) {
@@ -498,13 +562,17 @@ void DownloadMtprotoTask::removeSession(int sessionIndex) {
 			requestData.sessionIndex = newIndex;
 		}
 	}
-	for (const auto &[requestId, offset] : redirect) {
+	for (const auto &[requestId, offset, limit] : redirect) {
 		const auto needMakeRequest = (requestId != _cdnHashesRequestId);
 		cancelRequest(requestId);
 		if (needMakeRequest) {
 			const auto newIndex = _owner->chooseSessionIndex(dcId());
 			Assert(newIndex < sessionIndex);
-			makeRequest({ offset, newIndex });
+			makeRequest({
+				.offset = offset,
+				.sessionIndex = newIndex,
+				.limit = limit,
+			});
 		}
 	}
 }
@@ -512,7 +580,7 @@ void DownloadMtprotoTask::removeSession(int sessionIndex) {
 mtpRequestId DownloadMtprotoTask::sendRequest(
 		const RequestData &requestData) {
 	const auto offset = requestData.offset;
-	const auto limit = Storage::kDownloadPartSize;
+	const auto limit = requestData.limit;
 	const auto shiftedDcId = MTP::downloadDcId(
 		_cdnDcId ? _cdnDcId : dcId(),
 		requestData.sessionIndex);
@@ -595,6 +663,16 @@ bool DownloadMtprotoTask::setWebFileSizeHook(int64 size) {
 }
 
 void DownloadMtprotoTask::makeRequest(const RequestData &requestData) {
+	if (_cdnDcId && requestData.limit > kDownloadPartSize) {
+		// CDN file hashes are checked only for the parts of fixed size.
+		auto part = requestData;
+		part.limit = kDownloadPartSize;
+		const auto till = requestData.offset + requestData.limit;
+		for (; part.offset < till; part.offset += kDownloadPartSize) {
+			makeRequest(part);
+		}
+		return;
+	}
 	placeSentRequest(sendRequest(requestData), requestData);
 }
 
@@ -803,7 +881,7 @@ void DownloadMtprotoTask::placeSentRequest(
 	const auto amount = _owner->changeRequestedAmount(
 		dcId(),
 		requestData.sessionIndex,
-		Storage::kDownloadPartSize);
+		requestData.limit);
 	const auto [i, ok1] = _sentRequests.emplace(requestId, requestData);
 	const auto [j, ok2] = _requestByOffset.emplace(
 		requestData.offset,
@@ -829,7 +907,7 @@ auto DownloadMtprotoTask::finishSentRequest(
 	_owner->changeRequestedAmount(
 		dcId(),
 		result.sessionIndex,
-		-Storage::kDownloadPartSize);
+		-result.limit);
 	_sentRequests.erase(it);
 	const auto ok = _requestByOffset.remove(result.offset);
 
@@ -19,11 +19,12 @@ class Error;
 
 namespace Storage {
 
-// Different part sizes are not supported for now :(
-// Because we start downloading with some part size
-// and then we get a CDN-redirect where we support only
-// fixed part size download for hash checking.
+// Parts are always requested with sizes that are powers of two from
+// kDownloadPartSize up to kMaxDownloadPartSize, each one aligned by its
+// size. After a CDN-redirect we support only kDownloadPartSize parts,
+// because CDN file hashes are provided for such parts.
 constexpr auto kDownloadPartSize = 128 * 1024;
+constexpr auto kMaxDownloadPartSize = 1024 * 1024;
 
 class DownloadMtprotoTask;
 
@@ -81,6 +82,11 @@ private:
 		int requested = 0;
 		int successes = 0; // Since last timeout in this dc in any session.
 		int maxWaitedAmount = 0;
+		int partSize = 0;
+
+		// Smoothed estimations, updated after each successful request.
+		float64 bandwidth = 0.; // Bytes per millisecond.
+		crl::time duration = 0;
 	};
 	struct DcBalanceData {
 		DcBalanceData();
@@ -103,6 +109,10 @@ private:
 	void killSessions(MTP::DcId dcId);
 
 	void resetGeneration();
+	void updateEstimation(
+		DcSessionBalanceData &data,
+		int amountAtRequestStart,
+		crl::time duration);
 	void sessionTimedOut(MTP::DcId dcId, int index);
 	void removeSession(MTP::DcId dcId);
 
@@ -147,7 +157,7 @@ public:
 	[[nodiscard]] const Location &location() const;
 
 	[[nodiscard]] virtual bool readyToRequest() const = 0;
-	void loadPart(int sessionIndex);
+	void loadPart(int sessionIndex, int maxPartSize);
 	void removeSession(int sessionIndex);
 
 	void refreshFileReferenceFrom(
@@ -174,6 +184,7 @@ private:
 		mutable int sessionIndex = 0;
 		int requestedInSession = 0;
 		crl::time sent = 0;
+		int limit = kDownloadPartSize;
 
 		inline bool operator<(const RequestData &other) const {
 			return offset < other.offset;
@@ -197,7 +208,12 @@ private:
 	};
 
 	// Called only if readyToRequest() == true.
-	[[nodiscard]] virtual int64 takeNextRequestOffset() = 0;
+	// Returns the largest part size not greater than maxPartSize that
+	// can be requested at the next offset, kDownloadPartSize by default.
+	[[nodiscard]] virtual int chooseNextRequestLimit(int maxPartSize) const;
+
+	// Called only if readyToRequest() == true.
+	[[nodiscard]] virtual int64 takeNextRequestOffset(int limit) = 0;
 	virtual bool feedPart(int64 offset, const QByteArray &bytes) = 0;
 	virtual bool setWebFileSizeHook(int64 size);
 	virtual void cancelOnFail() = 0;
@@ -14,6 +14,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "mainwindow.h"
 #include "core/application.h"
 #include "core/file_location.h"
+#include "core/core_tracing.h"
 #include "storage/storage_account.h"
 #include "storage/file_download_mtproto.h"
 #include "storage/file_download_web.h"
@@ -287,6 +288,8 @@ void FileLoader::loadLocal(const Storage::Cache::Key &key) {
 				value = std::move(value),
 				done = std::move(callback)
 			]() mutable {
+				TRACE_SCOPE("Storage::ReadCachedImage");
+
 				auto read = Images::Read({ .content = value });
 				if (!read.image.isNull()) {
 					done(
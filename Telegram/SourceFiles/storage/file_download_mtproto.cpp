@@ -134,11 +134,28 @@ bool mtpFileLoader::readyToRequest() const {
 		&& (!_fullSize || _nextRequestOffset < _loadSize);
 }
 
-int64 mtpFileLoader::takeNextRequestOffset() {
+int mtpFileLoader::chooseNextRequestLimit(int maxPartSize) const {
 	Expects(readyToRequest());
 
+	// Web files are always loaded by fixed parts.
+	if (!v::is<StorageFileLocation>(location().data)) {
+		return Storage::kDownloadPartSize;
+	}
+	auto result = maxPartSize;
+	while (result > Storage::kDownloadPartSize
+		&& ((_nextRequestOffset % result)
+			|| (_loadSize && _nextRequestOffset + result / 2 >= _loadSize))) {
+		result /= 2;
+	}
+	return result;
+}
+
+int64 mtpFileLoader::takeNextRequestOffset(int limit) {
+	Expects(readyToRequest());
+	Expects(!(_nextRequestOffset % limit));
+
 	const auto result = _nextRequestOffset;
-	_nextRequestOffset += Storage::kDownloadPartSize;
+	_nextRequestOffset += limit;
 	return result;
 }
 
@@ -63,7 +63,8 @@ private:
 	void cancelHook() override;
 
 	bool readyToRequest() const override;
-	int64 takeNextRequestOffset() override;
+	int chooseNextRequestLimit(int maxPartSize) const override;
+	int64 takeNextRequestOffset(int limit) override;
 	bool feedPart(int64 offset, const QByteArray &bytes) override;
 	void cancelOnFail() override;
 	bool setWebFileSizeHook(int64 size) override;
@@ -26,8 +26,20 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 namespace Storage {
 namespace {
 
-// max 512kb uploaded at the same time in each session
-constexpr auto kMaxUploadFileParallelSize = MTP::kUploadSessionsCount * 512 * 1024;
+// How many files are uploaded at the same time.
+constexpr auto kMaxUploadFilesParallel = 4;
+
+// Each session starts with 512kb in flight and adapts to its throughput.
+constexpr auto kSessionStartSent = int64(512 * 1024);
+constexpr auto kSessionMinSent = int64(128 * 1024);
+constexpr auto kSessionMaxSent = int64(2 * 1024 * 1024);
+constexpr auto kSessionSentStep = int64(128 * 1024);
+
+// A part uploaded slower than that means the session is overloaded.
+constexpr auto kSlowPartDuration = 8 * crl::time(1000);
+
+// How much of a document is read ahead on a background thread.
+constexpr auto kReadAheadSize = 2 * 1024 * 1024;
 
 constexpr auto kDocumentMaxPartsCountDefault = 4000;
 
@@ -58,6 +70,13 @@ constexpr auto kKillSessionTimeout = 15 * crl::time(1000);
 
 } // namespace
 
+// Accessed only by one thread at a time: either by the single read
+// request in flight on a background thread or by the main thread.
+struct Uploader::DocumentReader {
+	std::unique_ptr<QFile> file;
+	HashMd5 md5;
+};
+
 struct Uploader::File {
 	File(const SendMediaReady &media);
 	File(const std::shared_ptr<FileLoadResult> &file);
@@ -74,15 +93,29 @@ struct Uploader::File {
 	SendMediaType type() const;
 	uint64 thumbId() const;
 	const QString &filename() const;
+	bool document() const;
+
+	UploadFileParts &parts();
+	uint64 partsOfId() const;
+	QByteArray &content();
+	const QString &filepath() const;
+	bool partsLeft() const;
 
-	HashMd5 md5Hash;
+	std::shared_ptr<DocumentReader> reader;
+	std::deque<QByteArray> readParts;
+	int docReadParts = 0;
+	bool reading = false;
 
-	std::unique_ptr<QFile> docFile;
 	int64 docSize = 0;
 	int64 docPartSize = 0;
 	int docSentParts = 0;
 	int docPartsCount = 0;
 
+	int requestsInFlight = 0;
+	int docRequestsInFlight = 0;
+	bool started = false;
+	bool finished = false;
+
 };
 
 Uploader::File::File(const SendMediaReady &media) : media(media) {
@@ -113,6 +146,7 @@ Uploader::File::File(const std::shared_ptr<FileLoadResult> &file)
 }
 
 void Uploader::File::setDocSize(int64 size) {
+	reader = std::make_shared<DocumentReader>();
 	docSize = size;
 	constexpr auto limit0 = 1024 * 1024;
 	constexpr auto limit1 = 32 * limit0;
@@ -150,6 +184,53 @@ const QString &Uploader::File::filename() const {
 	return file ? file->filename : media.filename;
 }
 
+bool Uploader::File::document() const {
+	const auto type = this->type();
+	return (type == SendMediaType::File)
+		|| (type == SendMediaType::ThemeFile)
+		|| (type == SendMediaType::Audio);
+}
+
+UploadFileParts &Uploader::File::parts() {
+	return file
+		? ((type() == SendMediaType::Photo
+			|| type() == SendMediaType::Secure)
+			? file->fileparts
+			: file->thumbparts)
+		: media.parts;
+}
+
+uint64 Uploader::File::partsOfId() const {
+	return file
+		? ((type() == SendMediaType::Photo
+			|| type() == SendMediaType::Secure)
+			? file->id
+			: file->thumbId)
+		: media.thumbId;
+}
+
+QByteArray &Uploader::File::content() {
+	return file ? file->content : media.data;
+}
+
+const QString &Uploader::File::filepath() const {
+	return file ? file->filepath : media.file;
+}
+
+bool Uploader::File::partsLeft() const {
+	const auto &parts = file
+		? ((type() == SendMediaType::Photo
+			|| type() == SendMediaType::Secure)
+			? file->fileparts
+			: file->thumbparts)
+		: media.parts;
+	return !parts.isEmpty() || (docSentParts < docPartsCount);
+}
+
+Uploader::SessionBalance::SessionBalance()
+: maxSent(kSessionStartSent) {
+}
+
 Uploader::Uploader(not_null<ApiWrap*> api)
 : _api(api)
 , _nextTimer([=] { sendNext(); })
@@ -356,32 +437,33 @@ void Uploader::upload(
 	sendNext();
 }
 
-void Uploader::currentFailed() {
-	auto j = queue.find(uploadingId);
-	if (j != queue.end()) {
-		const auto [msgId, file] = std::move(*j);
-		queue.erase(j);
-		notifyFailed(msgId, file);
-	}
 
-	cancelRequests();
-	dcMap.clear();
-	uploadingId = FullMsgId();
-	sentSize = 0;
-	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
-		sentSizes[i] = 0;
+FullMsgId Uploader::currentUploadId() const {
+	return _uploading.empty() ? FullMsgId() : _uploading.front();
+}
+
+void Uploader::fileFailed(FullMsgId fullId) {
+	cancelRequests(fullId);
+	_uploading.erase(
+		ranges::remove(_uploading, fullId),
+		end(_uploading));
+
+	auto i = queue.find(fullId);
+	if (i != queue.end()) {
+		const auto [msgId, file] = std::move(*i);
+		queue.erase(i);
+		notifyFailed(msgId, file);
 	}
 
-	sendNext();
+	// Uploads in the same chat could wait for this one to finish.
+	fireReady();
 }
 
 void Uploader::notifyFailed(FullMsgId id, const File &file) {
 	const auto type = file.type();
 	if (type == SendMediaType::Photo) {
 		_photoFailed.fire_copy(id);
-	} else if (type == SendMediaType::File
-		|| type == SendMediaType::ThemeFile
-		|| type == SendMediaType::Audio) {
+	} else if (file.document()) {
 		const auto document = session().data().document(file.id());
 		if (document->uploading()) {
 			document->status = FileUploadFailed;
@@ -390,7 +472,7 @@ void Uploader::notifyFailed(FullMsgId id, const File &file) {
 	} else if (type == SendMediaType::Secure) {
 		_secureFailed.fire_copy(id);
 	} else {
-		Unexpected("Type in Uploader::currentFailed.");
+		Unexpected("Type in Uploader::notifyFailed.");
 	}
 }
 
@@ -401,7 +483,7 @@ void Uploader::stopSessions() {
 }
 
 void Uploader::sendNext() {
-	if (sentSize >= kMaxUploadFileParallelSize || _pausedId.msg) {
+	if (_pausedId.msg) {
 		return;
 	}
 
@@ -416,229 +498,327 @@ void Uploader::sendNext() {
 	if (stopping) {
 		_stopSessionsTimer.cancel();
 	}
-	auto i = uploadingId.msg ? queue.find(uploadingId) : queue.begin();
-	if (!uploadingId.msg) {
-		uploadingId = i->first;
-	} else if (i == queue.end()) {
-		i = queue.begin();
-		uploadingId = i->first;
+	while (sendNextPart()) {
 	}
-	auto &uploadingData = i->second;
+	_nextTimer.callOnce(kUploadRequestInterval);
+}
 
-	auto todc = 0;
-	for (auto dc = 1; dc != MTP::kUploadSessionsCount; ++dc) {
-		if (sentSizes[dc] < sentSizes[todc]) {
-			todc = dc;
+bool Uploader::sendNextPart() {
+	if (chooseSession(0) < 0) {
+		return false;
+	}
+	for (const auto &fullId : _uploading) {
+		const auto i = queue.find(fullId);
+		Assert(i != queue.end());
+		if (sendPart(fullId, i->second)) {
+			return true;
+		}
+	}
+	if (int(_uploading.size()) >= kMaxUploadFilesParallel) {
+		return false;
+	}
+	for (auto &[fullId, file] : queue) {
+		if (file.started) {
+			continue;
 		}
+		file.started = true;
+		_uploading.push_back(fullId);
+		if (!sendPart(fullId, file)) {
+			checkFinished(fullId, file);
+		}
+		return true;
 	}
+	return false;
+}
 
-	auto &parts = uploadingData.file
-		? ((uploadingData.type() == SendMediaType::Photo
-			|| uploadingData.type() == SendMediaType::Secure)
-			? uploadingData.file->fileparts
-			: uploadingData.file->thumbparts)
-		: uploadingData.media.parts;
-	const auto partsOfId = uploadingData.file
-		? ((uploadingData.type() == SendMediaType::Photo
-			|| uploadingData.type() == SendMediaType::Secure)
-			? uploadingData.file->id
-			: uploadingData.file->thumbId)
-		: uploadingData.media.thumbId;
-	if (parts.isEmpty()) {
-		if (uploadingData.docSentParts >= uploadingData.docPartsCount) {
-			if (requestsSent.empty() && docRequestsSent.empty()) {
-				const auto options = uploadingData.file
-					? uploadingData.file->to.options
-					: Api::SendOptions();
-				const auto edit = uploadingData.file &&
-					uploadingData.file->to.replaceMediaOf;
-				const auto attachedStickers = uploadingData.file
-					? uploadingData.file->attachedStickers
-					: std::vector<MTPInputDocument>();
-				if (uploadingData.type() == SendMediaType::Photo) {
-					auto photoFilename = uploadingData.filename();
-					if (!photoFilename.endsWith(u".jpg"_q, Qt::CaseInsensitive)) {
-						// Server has some extensions checking for inputMediaUploadedPhoto,
-						// so force the extension to be .jpg anyway. It doesn't matter,
-						// because the filename from inputFile is not used anywhere.
-						photoFilename += u".jpg"_q;
-					}
-					const auto md5 = uploadingData.file
-						? uploadingData.file->filemd5
-						: uploadingData.media.jpeg_md5;
-					const auto file = MTP_inputFile(
-						MTP_long(uploadingData.id()),
-						MTP_int(uploadingData.partsCount),
-						MTP_string(photoFilename),
-						MTP_bytes(md5));
-					_photoReady.fire({
-						.fullId = uploadingId,
-						.info = {
-							.file = file,
-							.attachedStickers = attachedStickers,
-						},
-						.options = options,
-						.edit = edit,
-					});
-				} else if (uploadingData.type() == SendMediaType::File
-					|| uploadingData.type() == SendMediaType::ThemeFile
-					|| uploadingData.type() == SendMediaType::Audio) {
-					QByteArray docMd5(32, Qt::Uninitialized);
-					hashMd5Hex(uploadingData.md5Hash.result(), docMd5.data());
-
-					const auto file = (uploadingData.docSize > kUseBigFilesFrom)
-						? MTP_inputFileBig(
-							MTP_long(uploadingData.id()),
-							MTP_int(uploadingData.docPartsCount),
-							MTP_string(uploadingData.filename()))
-						: MTP_inputFile(
-							MTP_long(uploadingData.id()),
-							MTP_int(uploadingData.docPartsCount),
-							MTP_string(uploadingData.filename()),
-							MTP_bytes(docMd5));
-					const auto thumb = [&]() -> std::optional<MTPInputFile> {
-						if (!uploadingData.partsCount) {
-							return std::nullopt;
-						}
-						const auto thumbFilename = uploadingData.file
-							? uploadingData.file->thumbname
-							: (u"thumb."_q + uploadingData.media.thumbExt);
-						const auto thumbMd5 = uploadingData.file
-							? uploadingData.file->thumbmd5
-							: uploadingData.media.jpeg_md5;
-						return MTP_inputFile(
-							MTP_long(uploadingData.thumbId()),
-							MTP_int(uploadingData.partsCount),
-							MTP_string(thumbFilename),
-							MTP_bytes(thumbMd5));
-					}();
-					_documentReady.fire({
-						.fullId = uploadingId,
-						.info = {
-							.file = file,
-							.thumb = thumb,
-							.attachedStickers = attachedStickers,
-						},
-						.options = options,
-						.edit = edit,
-					});
-				} else if (uploadingData.type() == SendMediaType::Secure) {
-					_secureReady.fire({
-						uploadingId,
-						uploadingData.id(),
-						uploadingData.partsCount });
-				}
-				queue.erase(uploadingId);
-				uploadingId = FullMsgId();
-				sendNext();
-			}
-			return;
+int Uploader::chooseSession(int64 partSize) const {
+	const auto i = ranges::min_element(
+		_sessions,
+		ranges::less(),
+		&SessionBalance::sent);
+	return (!i->sent || i->sent + partSize <= i->maxSent)
+		? int(i - begin(_sessions))
+		: -1;
+}
+
+bool Uploader::sendPart(const FullMsgId &fullId, File &file) {
+	const auto send = [&](auto &&request, int64 size, bool documentPart) {
+		const auto session = chooseSession(size);
+		Assert(session >= 0);
+
+		const auto requestId = _api->request(
+			std::move(request)
+		).done([=](const MTPBool &result, mtpRequestId requestId) {
+			partLoaded(result, requestId);
+		}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
+			partFailed(error, requestId);
+		}).toDC(MTP::uploadDcId(session)).send();
+
+		auto &balance = _sessions[session];
+		balance.sent += size;
+		_requests.emplace(requestId, Request{
+			.fullId = fullId,
+			.size = size,
+			.session = session,
+			.sentInSessionAtStart = balance.sent,
+			.sent = crl::now(),
+			.documentPart = documentPart,
+		});
+		++file.requestsInFlight;
+		if (documentPart) {
+			++file.docRequestsInFlight;
 		}
+	};
 
-		auto &content = uploadingData.file
-			? uploadingData.file->content
-			: uploadingData.media.data;
-		QByteArray toSend;
-		if (content.isEmpty()) {
-			if (!uploadingData.docFile) {
-				const auto filepath = uploadingData.file
-					? uploadingData.file->filepath
-					: uploadingData.media.file;
-				uploadingData.docFile = std::make_unique<QFile>(filepath);
-				if (!uploadingData.docFile->open(QIODevice::ReadOnly)) {
-					currentFailed();
-					return;
-				}
-			}
-			toSend = uploadingData.docFile->read(uploadingData.docPartSize);
-			if (uploadingData.docSize <= kUseBigFilesFrom) {
-				uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
-			}
-		} else {
-			const auto offset = uploadingData.docSentParts
-				* uploadingData.docPartSize;
-			toSend = content.mid(offset, uploadingData.docPartSize);
-			if ((uploadingData.type() == SendMediaType::File
-				|| uploadingData.type() == SendMediaType::ThemeFile
-				|| uploadingData.type() == SendMediaType::Audio)
-				&& uploadingData.docSentParts <= kUseBigFilesFrom) {
-				uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
-			}
+	auto &parts = file.parts();
+	if (!parts.isEmpty()) {
+		const auto part = parts.begin();
+		if (chooseSession(part.value().size()) < 0) {
+			return false;
 		}
-		if ((toSend.size() > uploadingData.docPartSize)
-			|| ((toSend.size() < uploadingData.docPartSize
-				&& uploadingData.docSentParts + 1 != uploadingData.docPartsCount))) {
-			currentFailed();
-			return;
+		send(MTPupload_SaveFilePart(
+			MTP_long(file.partsOfId()),
+			MTP_int(part.key()),
+			MTP_bytes(part.value())
+		), part.value().size(), false);
+		parts.erase(part);
+		return true;
+	} else if (file.docSentParts >= file.docPartsCount) {
+		return false;
+	} else if (chooseSession(file.docPartSize) < 0) {
+		return false;
+	}
+
+	auto &content = file.content();
+	auto toSend = QByteArray();
+	if (content.isEmpty()) {
+		if (file.readParts.empty()) {
+			readDocumentParts(fullId, file);
+			return false;
 		}
-		mtpRequestId requestId;
-		if (uploadingData.docSize > kUseBigFilesFrom) {
-			requestId = _api->request(MTPupload_SaveBigFilePart(
-				MTP_long(uploadingData.id()),
-				MTP_int(uploadingData.docSentParts),
-				MTP_int(uploadingData.docPartsCount),
-				MTP_bytes(toSend)
-			)).done([=](const MTPBool &result, mtpRequestId requestId) {
-				partLoaded(result, requestId);
-			}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-				partFailed(error, requestId);
-			}).toDC(MTP::uploadDcId(todc)).send();
-		} else {
-			requestId = _api->request(MTPupload_SaveFilePart(
-				MTP_long(uploadingData.id()),
-				MTP_int(uploadingData.docSentParts),
-				MTP_bytes(toSend)
-			)).done([=](const MTPBool &result, mtpRequestId requestId) {
-				partLoaded(result, requestId);
-			}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-				partFailed(error, requestId);
-			}).toDC(MTP::uploadDcId(todc)).send();
+		toSend = std::move(file.readParts.front());
+		file.readParts.pop_front();
+		readDocumentParts(fullId, file);
+	} else {
+		const auto offset = file.docSentParts * file.docPartSize;
+		toSend = content.mid(offset, file.docPartSize);
+		if (file.docSize <= kUseBigFilesFrom) {
+			file.reader->md5.feed(toSend.constData(), toSend.size());
 		}
-		docRequestsSent.emplace(requestId, uploadingData.docSentParts);
-		dcMap.emplace(requestId, todc);
-		sentSize += uploadingData.docPartSize;
-		sentSizes[todc] += uploadingData.docPartSize;
+	}
+	if ((toSend.size() > file.docPartSize)
+		|| ((toSend.size() < file.docPartSize
+			&& file.docSentParts + 1 != file.docPartsCount))) {
+		fileFailed(fullId);
+		return true;
+	}
+	if (file.docSize > kUseBigFilesFrom) {
+		send(MTPupload_SaveBigFilePart(
+			MTP_long(file.id()),
+			MTP_int(file.docSentParts),
+			MTP_int(file.docPartsCount),
+			MTP_bytes(toSend)
+		), file.docPartSize, true);
+	} else {
+		send(MTPupload_SaveFilePart(
+			MTP_long(file.id()),
+			MTP_int(file.docSentParts),
+			MTP_bytes(toSend)
+		), file.docPartSize, true);
+	}
+	++file.docSentParts;
+	return true;
+}
 
-		uploadingData.docSentParts++;
+void Uploader::readDocumentParts(const FullMsgId &fullId, File &file) {
+	if (file.reading || !file.content().isEmpty()) {
+		return;
+	}
+	const auto queued = int64(file.readParts.size()) * file.docPartSize;
+	const auto count = std::min(
+		int((kReadAheadSize - queued) / file.docPartSize),
+		file.docPartsCount - file.docReadParts);
+	if (count <= 0) {
+		return;
+	}
+	file.reading = true;
+	file.docReadParts += count;
+
+	const auto reader = file.reader;
+	const auto path = file.filepath();
+	const auto partSize = file.docPartSize;
+	const auto feedMd5 = (file.docSize <= kUseBigFilesFrom);
+	crl::async([=, weak = base::make_weak(this)] {
+		auto parts = std::deque<QByteArray>();
+		auto failed = false;
+		if (!reader->file) {
+			reader->file = std::make_unique<QFile>(path);
+			failed = !reader->file->open(QIODevice::ReadOnly);
+		}
+		for (auto i = 0; !failed && i != count; ++i) {
+			parts.push_back(reader->file->read(partSize));
+			if (feedMd5) {
+				const auto &part = parts.back();
+				reader->md5.feed(part.constData(), part.size());
+			}
+		}
+		crl::on_main(weak, [=, parts = std::move(parts)]() mutable {
+			documentPartsRead(fullId, reader.get(), std::move(parts), failed);
+		});
+	});
+}
+
+void Uploader::documentPartsRead(
+		const FullMsgId &fullId,
+		not_null<DocumentReader*> reader,
+		std::deque<QByteArray> &&parts,
+		bool failed) {
+	const auto i = queue.find(fullId);
+	if (i == queue.end() || i->second.reader.get() != reader) {
+		return;
+	}
+	auto &file = i->second;
+	file.reading = false;
+	if (failed) {
+		fileFailed(fullId);
 	} else {
-		auto part = parts.begin();
+		for (auto &part : parts) {
+			file.readParts.push_back(std::move(part));
+		}
+	}
+	sendNext();
+}
 
-		const auto requestId = _api->request(MTPupload_SaveFilePart(
-			MTP_long(partsOfId),
-			MTP_int(part.key()),
-			MTP_bytes(part.value())
-		)).done([=](const MTPBool &result, mtpRequestId requestId) {
-			partLoaded(result, requestId);
-		}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-			partFailed(error, requestId);
-		}).toDC(MTP::uploadDcId(todc)).send();
-		requestsSent.emplace(requestId, part.value());
-		dcMap.emplace(requestId, todc);
-		sentSize += part.value().size();
-		sentSizes[todc] += part.value().size();
+void Uploader::checkFinished(const FullMsgId &fullId, File &file) {
+	if (file.finished || file.requestsInFlight || file.partsLeft()) {
+		return;
+	}
+	file.finished = true;
+	fireReady();
+}
+
+void Uploader::fireReady() {
+	// Media in one chat should be sent in the same order it was queued.
+	auto blocked = base::flat_set<PeerId>();
+	auto ready = std::vector<std::pair<FullMsgId, File>>();
+	for (auto i = begin(_uploading); i != end(_uploading);) {
+		const auto fullId = *i;
+		const auto j = queue.find(fullId);
+		Assert(j != queue.end());
+		if (!j->second.finished) {
+			blocked.emplace(fullId.peer);
+			++i;
+		} else if (blocked.contains(fullId.peer)) {
+			++i;
+		} else {
+			ready.emplace_back(fullId, std::move(j->second));
+			queue.erase(j);
+			i = _uploading.erase(i);
+		}
+	}
+	for (auto &[fullId, file] : ready) {
+		fireReady(fullId, file);
+	}
+}
 
-		parts.erase(part);
+void Uploader::fireReady(const FullMsgId &fullId, File &file) {
+	const auto options = file.file
+		? file.file->to.options
+		: Api::SendOptions();
+	const auto edit = file.file && file.file->to.replaceMediaOf;
+	const auto attachedStickers = file.file
+		? file.file->attachedStickers
+		: std::vector<MTPInputDocument>();
+	if (file.type() == SendMediaType::Photo) {
+		auto photoFilename = file.filename();
+		if (!photoFilename.endsWith(u".jpg"_q, Qt::CaseInsensitive)) {
+			// Server has some extensions checking for inputMediaUploadedPhoto,
+			// so force the extension to be .jpg anyway. It doesn't matter,
+			// because the filename from inputFile is not used anywhere.
+			photoFilename += u".jpg"_q;
+		}
+		const auto md5 = file.file
+			? file.file->filemd5
+			: file.media.jpeg_md5;
+		const auto inputFile = MTP_inputFile(
+			MTP_long(file.id()),
+			MTP_int(file.partsCount),
+			MTP_string(photoFilename),
+			MTP_bytes(md5));
+		_photoReady.fire({
+			.fullId = fullId,
+			.info = {
+				.file = inputFile,
+				.attachedStickers = attachedStickers,
+			},
+			.options = options,
+			.edit = edit,
+		});
+	} else if (file.document()) {
+		QByteArray docMd5(32, Qt::Uninitialized);
+		hashMd5Hex(file.reader->md5.result(), docMd5.data());
+
+		const auto inputFile = (file.docSize > kUseBigFilesFrom)
+			? MTP_inputFileBig(
+				MTP_long(file.id()),
+				MTP_int(file.docPartsCount),
+				MTP_string(file.filename()))
+			: MTP_inputFile(
+				MTP_long(file.id()),
+				MTP_int(file.docPartsCount),
+				MTP_string(file.filename()),
+				MTP_bytes(docMd5));
+		const auto thumb = [&]() -> std::optional<MTPInputFile> {
+			if (!file.partsCount) {
+				return std::nullopt;
+			}
+			const auto thumbFilename = file.file
+				? file.file->thumbname
+				: (u"thumb."_q + file.media.thumbExt);
+			const auto thumbMd5 = file.file
+				? file.file->thumbmd5
+				: file.media.jpeg_md5;
+			return MTP_inputFile(
+				MTP_long(file.thumbId()),
+				MTP_int(file.partsCount),
+				MTP_string(thumbFilename),
+				MTP_bytes(thumbMd5));
+		}();
+		_documentReady.fire({
+			.fullId = fullId,
+			.info = {
+				.file = inputFile,
+				.thumb = thumb,
+				.attachedStickers = attachedStickers,
+			},
+			.options = options,
+			.edit = edit,
+		});
+	} else if (file.type() == SendMediaType::Secure) {
+		_secureReady.fire({
+			fullId,
+			file.id(),
+			file.partsCount });
 	}
-	_nextTimer.callOnce(kUploadRequestInterval);
 }
 
 void Uploader::cancel(const FullMsgId &msgId) {
-	if (uploadingId == msgId) {
-		currentFailed();
+	if (ranges::find(_uploading, msgId) != end(_uploading)) {
+		fileFailed(msgId);
+		sendNext();
 	} else {
 		queue.erase(msgId);
 	}
 }
 
 void Uploader::cancelAll() {
-	const auto single = queue.empty() ? uploadingId : queue.begin()->first;
+	const auto single = queue.empty() ? FullMsgId() : queue.begin()->first;
 	if (!single) {
 		return;
 	}
 	_pausedId = single;
-	if (uploadingId) {
-		currentFailed();
-	}
+	cancelRequests();
+	_uploading.clear();
 	while (!queue.empty()) {
 		const auto [msgId, file] = std::move(*queue.begin());
 		queue.erase(queue.begin());
@@ -661,98 +841,117 @@ void Uploader::confirm(const FullMsgId &msgId) {
 }
 
 void Uploader::cancelRequests() {
-	for (const auto &requestData : requestsSent) {
-		_api->request(requestData.first).cancel();
+	for (const auto &[requestId, request] : _requests) {
+		_api->request(requestId).cancel();
 	}
-	requestsSent.clear();
-	for (const auto &requestData : docRequestsSent) {
-		_api->request(requestData.first).cancel();
+	_requests.clear();
+	for (auto &session : _sessions) {
+		session.sent = 0;
+	}
+}
+
+void Uploader::cancelRequests(const FullMsgId &fullId) {
+	for (auto i = begin(_requests); i != end(_requests);) {
+		if (i->second.fullId == fullId) {
+			_sessions[i->second.session].sent -= i->second.size;
+			_api->request(i->first).cancel();
+			i = _requests.erase(i);
+		} else {
+			++i;
+		}
 	}
-	docRequestsSent.clear();
 }
 
 void Uploader::clear() {
 	queue.clear();
+	_uploading.clear();
 	cancelRequests();
-	dcMap.clear();
-	sentSize = 0;
 	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
 		_api->instance().stopSession(MTP::uploadDcId(i));
-		sentSizes[i] = 0;
 	}
 	_stopSessionsTimer.cancel();
 }
 
+void Uploader::requestSucceeded(const Request &request) {
+	auto &session = _sessions[request.session];
+	const auto duration = crl::now() - request.sent;
+	if (duration >= kSlowPartDuration) {
+		session.maxSent = std::max(session.maxSent / 2, kSessionMinSent);
+		DEBUG_LOG(("Upload (%1) slow request, duration: %2, max sent %3."
+			).arg(request.session
+			).arg(duration
+			).arg(session.maxSent));
+	} else if (request.sentInSessionAtStart + kSessionSentStep
+			> session.maxSent
+		&& session.maxSent < kSessionMaxSent) {
+		session.maxSent = std::min(
+			session.maxSent + kSessionSentStep,
+			kSessionMaxSent);
+		DEBUG_LOG(("Upload (%1) increased max sent %2."
+			).arg(request.session
+			).arg(session.maxSent));
+	}
+}
+
 void Uploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
-	auto j = docRequestsSent.end();
-	auto i = requestsSent.find(requestId);
-	if (i == requestsSent.cend()) {
-		j = docRequestsSent.find(requestId);
-	}
-	if (i != requestsSent.cend() || j != docRequestsSent.cend()) {
-		if (mtpIsFalse(result)) { // failed to upload current file
-			currentFailed();
-			return;
-		} else {
-			auto dcIt = dcMap.find(requestId);
-			if (dcIt == dcMap.cend()) { // must not happen
-				currentFailed();
-				return;
-			}
-			auto dc = dcIt->second;
-			dcMap.erase(dcIt);
-
-			int64 sentPartSize = 0;
-			auto k = queue.find(uploadingId);
-			Assert(k != queue.cend());
-			auto &[fullId, file] = *k;
-			if (i != requestsSent.cend()) {
-				sentPartSize = i->second.size();
-				requestsSent.erase(i);
-			} else {
-				sentPartSize = file.docPartSize;
-				docRequestsSent.erase(j);
-			}
-			sentSize -= sentPartSize;
-			sentSizes[dc] -= sentPartSize;
-			if (file.type() == SendMediaType::Photo) {
-				file.fileSentSize += sentPartSize;
-				const auto photo = session().data().photo(file.id());
-				if (photo->uploading() && file.file) {
-					photo->uploadingData->size = file.file->partssize;
-					photo->uploadingData->offset = file.fileSentSize;
-				}
-				_photoProgress.fire_copy(fullId);
-			} else if (file.type() == SendMediaType::File
-				|| file.type() == SendMediaType::ThemeFile
-				|| file.type() == SendMediaType::Audio) {
-				const auto document = session().data().document(file.id());
-				if (document->uploading()) {
-					const auto doneParts = file.docSentParts
-						- int(docRequestsSent.size());
-					document->uploadingData->offset = std::min(
-						document->uploadingData->size,
-						doneParts * file.docPartSize);
-				}
-				_documentProgress.fire_copy(fullId);
-			} else if (file.type() == SendMediaType::Secure) {
-				file.fileSentSize += sentPartSize;
-				_secureProgress.fire_copy({
-					fullId,
-					file.fileSentSize,
-					file.file->partssize });
-			}
+	const auto i = _requests.find(requestId);
+	if (i == end(_requests)) {
+		sendNext();
+		return;
+	}
+	const auto request = i->second;
+	_requests.erase(i);
+	_sessions[request.session].sent -= request.size;
+
+	const auto k = queue.find(request.fullId);
+	Assert(k != queue.cend());
+	auto &[fullId, file] = *k;
+	--file.requestsInFlight;
+	if (request.documentPart) {
+		--file.docRequestsInFlight;
+	}
+	if (mtpIsFalse(result)) { // failed to upload current file
+		fileFailed(request.fullId);
+		sendNext();
+		return;
+	}
+	requestSucceeded(request);
+
+	if (file.type() == SendMediaType::Photo) {
+		file.fileSentSize += request.size;
+		const auto photo = session().data().photo(file.id());
+		if (photo->uploading() && file.file) {
+			photo->uploadingData->size = file.file->partssize;
+			photo->uploadingData->offset = file.fileSentSize;
 		}
+		_photoProgress.fire_copy(fullId);
+	} else if (file.document()) {
+		const auto document = session().data().document(file.id());
+		if (document->uploading()) {
+			const auto doneParts = file.docSentParts
+				- file.docRequestsInFlight;
+			document->uploadingData->offset = std::min(
+				document->uploadingData->size,
+				doneParts * file.docPartSize);
+		}
+		_documentProgress.fire_copy(fullId);
+	} else if (file.type() == SendMediaType::Secure) {
+		file.fileSentSize += request.size;
+		_secureProgress.fire_copy({
+			fullId,
+			file.fileSentSize,
+			file.file->partssize });
 	}
-
+	checkFinished(request.fullId, k->second);
 	sendNext();
 }
 
 void Uploader::partFailed(const MTP::Error &error, mtpRequestId requestId) {
 	// failed to upload current file
-	if ((requestsSent.find(requestId) != requestsSent.cend())
-		|| (docRequestsSent.find(requestId) != docRequestsSent.cend())) {
-		currentFailed();
+	const auto i = _requests.find(requestId);
+	if (i != end(_requests)) {
+		const auto fullId = i->second.fullId;
+		fileFailed(fullId);
 	}
 	sendNext();
 }
@@ -9,6 +9,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 
 #include "api/api_common.h"
 #include "base/timer.h"
+#include "base/weak_ptr.h"
 #include "mtproto/facade.h"
 
 class ApiWrap;
@@ -47,16 +48,14 @@ struct UploadSecureDone {
 	int partsCount = 0;
 };
 
-class Uploader final : public QObject {
+class Uploader final : public QObject, public base::has_weak_ptr {
 public:
 	explicit Uploader(not_null<ApiWrap*> api);
 	~Uploader();
 
 	[[nodiscard]] Main::Session &session() const;
 
-	[[nodiscard]] FullMsgId currentUploadId() const {
-		return uploadingId;
-	}
+	[[nodiscard]] FullMsgId currentUploadId() const;
 
 	void uploadMedia(const FullMsgId &msgId, const SendMediaReady &image);
 	void upload(
@@ -103,7 +102,36 @@ public:
 	void stopSessions();
 
 private:
+	struct DocumentReader;
 	struct File;
+	struct Request {
+		FullMsgId fullId;
+		int64 size = 0;
+		int session = 0;
+		int64 sentInSessionAtStart = 0;
+		crl::time sent = 0;
+		bool documentPart = false;
+	};
+	struct SessionBalance {
+		SessionBalance();
+
+		int64 sent = 0;
+		int64 maxSent = 0;
+	};
+
+	[[nodiscard]] bool sendNextPart();
+	[[nodiscard]] bool sendPart(const FullMsgId &fullId, File &file);
+	[[nodiscard]] int chooseSession(int64 partSize) const;
+	void readDocumentParts(const FullMsgId &fullId, File &file);
+	void documentPartsRead(
+		const FullMsgId &fullId,
+		not_null<DocumentReader*> reader,
+		std::deque<QByteArray> &&parts,
+		bool failed);
+	void checkFinished(const FullMsgId &fullId, File &file);
+	void fireReady();
+	void fireReady(const FullMsgId &fullId, File &file);
+	void requestSucceeded(const Request &request);
 
 	void partLoaded(const MTPBool &result, mtpRequestId requestId);
 	void partFailed(const MTP::Error &error, mtpRequestId requestId);
@@ -114,8 +142,9 @@ private:
 	void processDocumentFailed(const FullMsgId &msgId);
 
 	void notifyFailed(FullMsgId id, const File &file);
-	void currentFailed();
+	void fileFailed(FullMsgId fullId);
 	void cancelRequests();
+	void cancelRequests(const FullMsgId &fullId);
 
 	void sendProgressUpdate(
 		not_null<HistoryItem*> item,
@@ -123,13 +152,10 @@ private:
 		int progress = 0);
 
 	const not_null<ApiWrap*> _api;
-	base::flat_map<mtpRequestId, QByteArray> requestsSent;
-	base::flat_map<mtpRequestId, int32> docRequestsSent;
-	base::flat_map<mtpRequestId, int32> dcMap;
-	uint32 sentSize = 0; // FileSize: Right now any file size fits 32 bit.
-	uint32 sentSizes[MTP::kUploadSessionsCount] = { 0 };
+	base::flat_map<mtpRequestId, Request> _requests;
+	std::array<SessionBalance, MTP::kUploadSessionsCount> _sessions;
 
-	FullMsgId uploadingId;
+	std::vector<FullMsgId> _uploading; // In the order uploads started.
 	FullMsgId _pausedId;
 	std::map<FullMsgId, File> queue;
 	base::Timer _nextTimer, _stopSessionsTimer;
@@ -17,6 +17,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "base/options.h"
 #include "base/unixtime.h"
 #include "base/random.h"
+#include "base/invoke_queued.h"
 #include "editor/scene/scene_item_sticker.h"
 #include "editor/scene/scene.h"
 #include "media/audio/media_audio.h"
@@ -309,7 +310,8 @@ SendMediaReady::SendMediaReady(
 	}
 }
 
-TaskQueue::TaskQueue(crl::time stopTimeoutMs) {
+TaskQueue::TaskQueue(crl::time stopTimeoutMs, int threads)
+: _threadsLimit(std::max(threads, 1)) {
 	if (stopTimeoutMs > 0) {
 		_stopTimer = new QTimer(this);
 		connect(_stopTimer, SIGNAL(timeout()), this, SLOT(stop()));
@@ -342,16 +344,19 @@ void TaskQueue::addTasks(std::vector<std::unique_ptr<Task>> &&tasks) {
 }
 
 void TaskQueue::wakeThread() {
-	if (!_thread) {
-		_thread = new QThread();
-
-		_worker = new TaskQueueWorker(this);
-		_worker->moveToThread(_thread);
-
-		connect(this, SIGNAL(taskAdded()), _worker, SLOT(onTaskAdded()));
-		connect(_worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
-
-		_thread->start();
+	if (_threads.empty()) {
+		for (auto i = 0; i != _threadsLimit; ++i) {
+			const auto thread = new QThread();
+			const auto worker = new TaskQueueWorker(this);
+			worker->moveToThread(thread);
+
+			connect(this, SIGNAL(taskAdded()), worker, SLOT(onTaskAdded()));
+			connect(worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
+
+			thread->start();
+			_threads.push_back(thread);
+			_workers.push_back(worker);
+		}
 	}
 	if (_stopTimer) _stopTimer->stop();
 	taskAdded();
@@ -370,8 +375,12 @@ void TaskQueue::cancelTask(TaskId id) {
 	{
 		QMutexLocker lock(&_tasksToProcessMutex);
 		removeFrom(_tasksToProcess);
-		if (_taskInProcessId == id) {
-			_taskInProcessId = TaskId();
+		const auto i = ranges::find(_tasksInProcess, id, &InProcess::id);
+		if (i != _tasksInProcess.end()) {
+			_tasksInProcess.erase(i);
+			if (moveProcessedToFinish()) {
+				InvokeQueued(this, [=] { onTaskProcessed(); });
+			}
 		}
 	}
 	QMutexLocker lock(&_tasksToFinishMutex);
@@ -392,24 +401,64 @@ void TaskQueue::onTaskProcessed() {
 
 	if (_stopTimer) {
 		QMutexLocker lock(&_tasksToProcessMutex);
-		if (_tasksToProcess.empty() && !_taskInProcessId) {
+		if (_tasksToProcess.empty() && _tasksInProcess.empty()) {
 			_stopTimer->start();
 		}
 	}
 }
 
+std::unique_ptr<Task> TaskQueue::takeTaskToProcess() {
+	if (_tasksToProcess.empty()) {
+		return nullptr;
+	}
+	auto result = std::move(_tasksToProcess.front());
+	_tasksToProcess.pop_front();
+	_tasksInProcess.push_back({ .id = result->id() });
+	return result;
+}
+
+bool TaskQueue::taskProcessed(std::unique_ptr<Task> &&task) {
+	const auto i = ranges::find(_tasksInProcess, task->id(), &InProcess::id);
+	if (i == _tasksInProcess.end()) {
+		// Canceled while was processed.
+		return false;
+	}
+	i->processed = std::move(task);
+	return moveProcessedToFinish();
+}
+
+bool TaskQueue::moveProcessedToFinish() {
+	// Tasks processed ahead of the earlier ones wait for them to finish.
+	QMutexLocker lock(&_tasksToFinishMutex);
+	const auto wasEmpty = _tasksToFinish.empty();
+	while (!_tasksInProcess.empty() && _tasksInProcess.front().processed) {
+		_tasksToFinish.push_back(
+			std::move(_tasksInProcess.front().processed));
+		_tasksInProcess.pop_front();
+	}
+	return wasEmpty && !_tasksToFinish.empty();
+}
+
 void TaskQueue::stop() {
-	if (_thread) {
-		_thread->requestInterruption();
-		_thread->quit();
+	for (const auto thread : _threads) {
+		thread->requestInterruption();
+		thread->quit();
+	}
+	if (!_threads.empty()) {
 		DEBUG_LOG(("Waiting for taskThread to finish"));
-		_thread->wait();
-		delete base::take(_worker);
-		delete base::take(_thread);
+	}
+	for (const auto thread : _threads) {
+		thread->wait();
+	}
+	for (const auto worker : base::take(_workers)) {
+		delete worker;
+	}
+	for (const auto thread : base::take(_threads)) {
+		delete thread;
 	}
 	_tasksToProcess.clear();
 	_tasksToFinish.clear();
-	_taskInProcessId = TaskId();
+	_tasksInProcess.clear();
 }
 
 TaskQueue::~TaskQueue() {
@@ -426,26 +475,17 @@ void TaskQueueWorker::onTaskAdded() {
 		auto task = std::unique_ptr<Task>();
 		{
 			QMutexLocker lock(&_queue->_tasksToProcessMutex);
-			if (!_queue->_tasksToProcess.empty()) {
-				task = std::move(_queue->_tasksToProcess.front());
-				_queue->_tasksToProcess.pop_front();
-				_queue->_taskInProcessId = task->id();
-			}
+			task = _queue->takeTaskToProcess();
 		}
 
+		someTasksLeft = false;
 		if (task) {
 			task->process();
 			bool emitTaskProcessed = false;
 			{
-				QMutexLocker lockToProcess(&_queue->_tasksToProcessMutex);
-				if (_queue->_taskInProcessId == task->id()) {
-					_queue->_taskInProcessId = TaskId();
-					someTasksLeft = !_queue->_tasksToProcess.empty();
-
-					QMutexLocker lockToFinish(&_queue->_tasksToFinishMutex);
-					emitTaskProcessed = _queue->_tasksToFinish.empty();
-					_queue->_tasksToFinish.push_back(std::move(task));
-				}
+				QMutexLocker lock(&_queue->_tasksToProcessMutex);
+				emitTaskProcessed = _queue->taskProcessed(std::move(task));
+				someTasksLeft = !_queue->_tasksToProcess.empty();
 			}
 			if (emitTaskProcessed) {
 				taskProcessed();
@@ -59,6 +59,7 @@ constexpr auto kMultiDraftTagOld = quint64(0xFFFF'FFFF'FFFF'FF01ULL);
 constexpr auto kMultiDraftCursorsTagOld = quint64(0xFFFF'FFFF'FFFF'FF02ULL);
 constexpr auto kMultiDraftTag = quint64(0xFFFF'FFFF'FFFF'FF03ULL);
 constexpr auto kMultiDraftCursorsTag = quint64(0xFFFF'FFFF'FFFF'FF04ULL);
+constexpr auto kMaxHistoryCacheCount = 256;
 
 enum { // Local Storage Keys
 	lskUserMap = 0x00,
@@ -85,6 +86,7 @@ enum { // Local Storage Keys
 	lskSelfSerialized = 0x15, // serialized self
 	lskMasksKeys = 0x16, // no data
 	lskCustomEmojiKeys = 0x17, // no data
+	lskHistoryCache = 0x18, // data: PeerId peer
 };
 
 auto EmptyMessageDraftSources()
@@ -231,6 +233,9 @@ base::flat_set<QString> Account::collectGoodNames() const {
 	for (const auto &[key, value] : _draftCursorsMap) {
 		push(value);
 	}
+	for (const auto &[key, value] : _historyCacheMap) {
+		push(value);
+	}
 	for (const auto &value : keys) {
 		push(value);
 	}
@@ -284,6 +289,8 @@ Account::ReadMapResult Account::readMapWith(
 	base::flat_map<PeerId, FileKey> draftsMap;
 	base::flat_map<PeerId, FileKey> draftCursorsMap;
 	base::flat_map<PeerId, bool> draftsNotReadMap;
+	base::flat_map<PeerId, FileKey> historyCacheMap;
+	std::deque<PeerId> historyCacheOrder;
 	quint64 locationsKey = 0, reportSpamStatusesKey = 0, trustedBotsKey = 0;
 	quint64 recentStickersKeyOld = 0;
 	quint64 installedStickersKey = 0, featuredStickersKey = 0, recentStickersKey = 0, favedStickersKey = 0, archivedStickersKey = 0;
@@ -322,6 +329,19 @@ Account::ReadMapResult Account::readMapWith(
 				draftCursorsMap.emplace(peerId, key);
 			}
 		} break;
+		case lskHistoryCache: {
+			quint32 count = 0;
+			map.stream >> count;
+			for (quint32 i = 0; i < count; ++i) {
+				FileKey key;
+				quint64 peerIdSerialized;
+				map.stream >> key >> peerIdSerialized;
+				const auto peerId = DeserializePeerId(peerIdSerialized);
+				if (historyCacheMap.emplace(peerId, key).second) {
+					historyCacheOrder.push_back(peerId);
+				}
+			}
+		} break;
 		case lskLegacyImages:
 		case lskLegacyStickerImages:
 		case lskLegacyAudios: {
@@ -411,6 +431,8 @@ Account::ReadMapResult Account::readMapWith(
 	_draftsMap = draftsMap;
 	_draftCursorsMap = draftCursorsMap;
 	_draftsNotReadMap = draftsNotReadMap;
+	_historyCacheMap = std::move(historyCacheMap);
+	_historyCacheOrder = std::move(historyCacheOrder);
 
 	_locationsKey = locationsKey;
 	_trustedBotsKey = trustedBotsKey;
@@ -520,6 +542,7 @@ void Account::writeMap() {
 	if (!self.isEmpty()) mapSize += sizeof(quint32) + Serialize::bytearraySize(self);
 	if (!_draftsMap.empty()) mapSize += sizeof(quint32) * 2 + _draftsMap.size() * sizeof(quint64) * 2;
 	if (!_draftCursorsMap.empty()) mapSize += sizeof(quint32) * 2 + _draftCursorsMap.size() * sizeof(quint64) * 2;
+	if (!_historyCacheMap.empty()) mapSize += sizeof(quint32) * 2 + _historyCacheMap.size() * sizeof(quint64) * 2;
 	if (_locationsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_trustedBotsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_recentStickersKeyOld) mapSize += sizeof(quint32) + sizeof(quint64);
@@ -554,6 +577,14 @@ void Account::writeMap() {
 			mapData.stream << quint64(value) << SerializePeerId(key);
 		}
 	}
+	if (!_historyCacheMap.empty()) {
+		mapData.stream << quint32(lskHistoryCache) << quint32(_historyCacheMap.size());
+		for (const auto peerId : _historyCacheOrder) {
+			const auto i = _historyCacheMap.find(peerId);
+			Assert(i != end(_historyCacheMap));
+			mapData.stream << quint64(i->second) << SerializePeerId(peerId);
+		}
+	}
 	if (_locationsKey) {
 		mapData.stream << quint32(lskLocations) << quint64(_locationsKey);
 	}
@@ -606,6 +637,8 @@ void Account::reset() {
 	_draftsMap.clear();
 	_draftCursorsMap.clear();
 	_draftsNotReadMap.clear();
+	_historyCacheMap.clear();
+	_historyCacheOrder.clear();
 	_locationsKey = _trustedBotsKey = 0;
 	_recentStickersKeyOld = 0;
 	_installedStickersKey = 0;
@@ -1486,6 +1519,99 @@ bool Account::hasDraft(PeerId peer) {
 	return _draftsMap.contains(peer);
 }
 
+void Account::writeHistoryCache(
+		PeerId peerId,
+		const MTPmessages_Messages &slice) {
+	if (slice.type() == mtpc_messages_messagesNotModified) {
+		return;
+	}
+	auto buffer = mtpBuffer();
+	slice.write(buffer);
+	const auto serialized = QByteArray(
+		reinterpret_cast<const char*>(buffer.constData()),
+		buffer.size() * sizeof(mtpPrime));
+
+	auto i = _historyCacheMap.find(peerId);
+	if (i == _historyCacheMap.cend()) {
+		while (int(_historyCacheOrder.size()) >= kMaxHistoryCacheCount) {
+			clearHistoryCache(_historyCacheOrder.front());
+		}
+		i = _historyCacheMap.emplace(peerId, GenerateKey(_basePath)).first;
+		_historyCacheOrder.push_back(peerId);
+		writeMapQueued();
+	} else {
+		touchHistoryCache(peerId);
+		writeMapDelayed();
+	}
+
+	EncryptedDescriptor data(
+		sizeof(quint64) + Serialize::bytearraySize(serialized));
+	data.stream << SerializePeerId(peerId) << serialized;
+
+	FileWriteDescriptor file(i->second, _basePath);
+	file.writeEncrypted(data, _localKey);
+}
+
+std::optional<MTPmessages_Messages> Account::readHistoryCache(
+		PeerId peerId) {
+	const auto i = _historyCacheMap.find(peerId);
+	if (i == _historyCacheMap.cend()) {
+		return std::nullopt;
+	}
+
+	FileReadDescriptor cache;
+	if (!ReadEncryptedFile(cache, i->second, _basePath, _localKey)) {
+		clearHistoryCache(peerId);
+		return std::nullopt;
+	}
+
+	quint64 peerIdSerialized = 0;
+	QByteArray serialized;
+	cache.stream >> peerIdSerialized >> serialized;
+	if (!CheckStreamStatus(cache.stream)
+		|| DeserializePeerId(peerIdSerialized) != peerId
+		|| (serialized.size() % sizeof(mtpPrime)) != 0) {
+		clearHistoryCache(peerId);
+		return std::nullopt;
+	}
+
+	auto from = reinterpret_cast<const mtpPrime*>(serialized.constData());
+	const auto till = from + (serialized.size() / sizeof(mtpPrime));
+	auto result = MTPmessages_Messages();
+	if (!result.read(from, till) || from != till) {
+		LOG(("App Error: could not read history cache for peer %1."
+			).arg(peerId.value));
+		clearHistoryCache(peerId);
+		return std::nullopt;
+	}
+	return result;
+}
+
+void Account::clearHistoryCache(PeerId peerId) {
+	const auto i = _historyCacheMap.find(peerId);
+	if (i == _historyCacheMap.cend()) {
+		return;
+	}
+	ClearKey(i->second, _basePath);
+	_historyCacheMap.erase(i);
+	_historyCacheOrder.erase(
+		ranges::remove(_historyCacheOrder, peerId),
+		end(_historyCacheOrder));
+	writeMapDelayed();
+}
+
+bool Account::hasHistoryCache(PeerId peerId) const {
+	return _historyCacheMap.contains(peerId);
+}
+
+void Account::touchHistoryCache(PeerId peerId) {
+	const auto i = ranges::find(_historyCacheOrder, peerId);
+	if (i != end(_historyCacheOrder)) {
+		_historyCacheOrder.erase(i);
+	}
+	_historyCacheOrder.push_back(peerId);
+}
+
 void Account::writeFileLocation(MediaKey location, const Core::FileLocation &local) {
 	if (local.fname.isEmpty()) {
 		return;
@@ -2607,6 +2733,7 @@ void Account::writeExportSettings(const Export::Settings &settings) {
 		&& settings.path == check.path
 		&& settings.format == check.format
 		&& settings.availableAt == check.availableAt
+		&& settings.incremental == check.incremental
 		&& !settings.onlySinglePeer()) {
 		if (_exportSettingsKey) {
 			ClearKey(_exportSettingsKey, _basePath);
@@ -2621,7 +2748,7 @@ void Account::writeExportSettings(const Export::Settings &settings) {
 	}
 	quint32 size = sizeof(quint32) * 6
 		+ Serialize::stringSize(settings.path)
-		+ sizeof(qint32) * 2 + sizeof(quint64);
+		+ sizeof(qint32) * 3 + sizeof(quint64);
 	EncryptedDescriptor data(size);
 	data.stream
 		<< quint32(settings.types)
@@ -2654,6 +2781,7 @@ void Account::writeExportSettings(const Export::Settings &settings) {
 	});
 	data.stream << qint32(settings.singlePeerFrom);
 	data.stream << qint32(settings.singlePeerTill);
+	data.stream << qint32(settings.incremental ? 1 : 0);
 
 	FileWriteDescriptor file(_exportSettingsKey, _basePath);
 	file.writeEncrypted(data, _localKey);
@@ -2676,6 +2804,7 @@ Export::Settings Account::readExportSettings() {
 	quint64 singlePeerBareId = 0;
 	quint64 singlePeerAccessHash = 0;
 	qint32 singlePeerFrom = 0, singlePeerTill = 0;
+	qint32 incremental = 0;
 	file.stream
 		>> types
 		>> fullChats
@@ -2706,6 +2835,9 @@ Export::Settings Account::readExportSettings() {
 	if (!file.stream.atEnd()) {
 		file.stream >> singlePeerFrom >> singlePeerTill;
 	}
+	if (!file.stream.atEnd()) {
+		file.stream >> incremental;
+	}
 	auto result = Export::Settings();
 	result.types = Export::Settings::Types::from_raw(types);
 	result.fullChats = Export::Settings::Types::from_raw(fullChats);
@@ -2714,6 +2846,7 @@ Export::Settings Account::readExportSettings() {
 	result.format = Export::Output::Format(format);
 	result.path = path;
 	result.availableAt = availableAt;
+	result.incremental = (incremental == 1);
 	result.singlePeer = [&] {
 		switch (singlePeerType) {
 		case kSinglePeerTypeUserOld:
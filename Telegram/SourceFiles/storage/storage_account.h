@@ -97,6 +97,14 @@ public:
 	[[nodiscard]] bool hasDraftCursors(PeerId peerId);
 	[[nodiscard]] bool hasDraft(PeerId peerId);
 
+	void writeHistoryCache(
+		PeerId peerId,
+		const MTPmessages_Messages &slice);
+	[[nodiscard]] std::optional<MTPmessages_Messages> readHistoryCache(
+		PeerId peerId);
+	void clearHistoryCache(PeerId peerId);
+	[[nodiscard]] bool hasHistoryCache(PeerId peerId) const;
+
 	void writeFileLocation(
 		MediaKey location,
 		const Core::FileLocation &local);
@@ -227,6 +235,8 @@ private:
 		details::FileReadDescriptor &draft,
 		quint64 draftPeerSerialized);
 
+	void touchHistoryCache(PeerId peerId);
+
 	void writeStickerSet(
 		QDataStream &stream,
 		const Data::StickersSet &set);
@@ -264,6 +274,9 @@ private:
 		not_null<History*>,
 		base::flat_map<Data::DraftKey, MessageDraftSource>> _draftSources;
 
+	base::flat_map<PeerId, FileKey> _historyCacheMap;
+	std::deque<PeerId> _historyCacheOrder; // Least recently written first.
+
 	QMultiMap<MediaKey, Core::FileLocation> _fileLocations;
 	QMap<QString, QPair<MediaKey, Core::FileLocation>> _fileLocationPairs;
 	QMap<MediaKey, MediaKey> _fileLocationAliases;
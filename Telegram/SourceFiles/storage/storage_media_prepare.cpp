@@ -14,6 +14,7 @@ https://github.com/xmdnx/exteraGramDesktop/blob/dev/LEGAL
 #include "ui/image/image_prepare.h"
 #include "ui/chat/attach/attach_prepare.h"
 #include "core/crash_reports.h"
+#include "core/core_tracing.h"
 
 #include <QtCore/QSemaphore>
 #include <QtCore/QMimeData>
@@ -64,6 +65,8 @@ void PrepareDetailsInParallel(PreparedList &result, int previewWidth) {
 	QSemaphore semaphore;
 	for (auto &file : result.files) {
 		crl::async([=, &semaphore, &file] {
+			TRACE_SCOPE("Storage::PrepareDetails");
+
 			PrepareDetails(file, previewWidth, sideLimit);
 			semaphore.release();
 		});
@@ -297,6 +297,74 @@ QPainterPath PathFromInlineBytes(const QByteArray &bytes) {
 
 } // namespace Images
 
+namespace {
+
+constexpr auto kSharedCacheLimit = int64(64 * 1024 * 1024);
+
+struct SharedKey {
+	const Image *image = nullptr;
+	int width = 0;
+	int height = 0;
+	int outerWidth = 0;
+	int outerHeight = 0;
+	int ratio = 0;
+	uint64 options = 0;
+	QRgb colored = 0;
+
+	friend inline auto operator<=>(SharedKey, SharedKey) = default;
+};
+
+struct SharedEntry {
+	QPixmap pixmap;
+	int64 bytes = 0;
+	uint64 lastUsed = 0;
+};
+
+struct SharedCache {
+	std::map<SharedKey, SharedEntry> entries;
+	int64 bytes = 0;
+	uint64 lastUsed = 0;
+};
+
+[[nodiscard]] SharedCache &Shared() {
+	// Never destroyed, so that static images may use it at exit.
+	static const auto result = new SharedCache();
+	return *result;
+}
+
+[[nodiscard]] int64 PixmapBytes(const QPixmap &pixmap) {
+	return int64(pixmap.width()) * pixmap.height() * 4;
+}
+
+void TrimShared(int64 limit) {
+	auto &cache = Shared();
+	if (cache.bytes <= limit) {
+		return;
+	}
+	auto list = std::vector<std::pair<uint64, SharedKey>>();
+	list.reserve(cache.entries.size());
+	for (const auto &[key, entry] : cache.entries) {
+		list.emplace_back(entry.lastUsed, key);
+	}
+	ranges::sort(list, ranges::less(), [](const auto &pair) {
+		return pair.first;
+	});
+
+	// Free a quarter of the budget at once, so that the sort above
+	// doesn't run each time a new pixmap is added to a full cache.
+	const auto till = limit - (limit / 4);
+	for (const auto &[lastUsed, key] : list) {
+		if (cache.bytes <= till) {
+			break;
+		}
+		const auto i = cache.entries.find(key);
+		cache.bytes -= i->second.bytes;
+		cache.entries.erase(i);
+	}
+}
+
+} // namespace
+
 Image::Image(const QString &path)
 : Image(Read({ .path = path }).image) {
 }
@@ -310,6 +378,18 @@ Image::Image(QImage &&data)
 	Expects(!_data.isNull());
 }
 
+Image::~Image() {
+	if (!_sharedCached) {
+		return;
+	}
+	auto &cache = Shared();
+	auto i = cache.entries.lower_bound(SharedKey{ .image = this });
+	while (i != end(cache.entries) && i->first.image == this) {
+		cache.bytes -= i->second.bytes;
+		i = cache.entries.erase(i);
+	}
+}
+
 not_null<Image*> Image::Empty() {
 	static auto result = Image([] {
 		const auto factor = cIntRetinaFactor();
@@ -366,6 +446,51 @@ const QPixmap &Image::cached(
 		: _cache.emplace_or_assign(k, prepare(w, h, args)).first->second;
 }
 
+QPixmap Image::shared(int w, int h, const Images::PrepareArgs &args) const {
+	const auto ratio = style::DevicePixelRatio();
+	const auto key = SharedKey{
+		.image = this,
+		.width = w,
+		.height = h,
+		.outerWidth = args.outer.width(),
+		.outerHeight = args.outer.height(),
+		.ratio = ratio,
+		.options = static_cast<uint64>(OptionsByArgs(args)),
+		.colored = args.colored ? (*args.colored)->c.rgba() : QRgb(),
+	};
+	auto &cache = Shared();
+	const auto i = cache.entries.find(key);
+	if (i != end(cache.entries)) {
+		i->second.lastUsed = ++cache.lastUsed;
+		return i->second.pixmap;
+	}
+	auto result = prepare(w, h, args);
+	const auto bytes = PixmapBytes(result);
+	if (bytes <= kSharedCacheLimit / 16) {
+		cache.entries.emplace(key, SharedEntry{
+			.pixmap = result,
+			.bytes = bytes,
+			.lastUsed = ++cache.lastUsed,
+		});
+		cache.bytes += bytes;
+		_sharedCached = true;
+		TrimShared(kSharedCacheLimit);
+	}
+	return result;
+}
+
+Image::SharedCacheStatistics Image::SharedStatistics() {
+	const auto &cache = Shared();
+	return {
+		.count = int(cache.entries.size()),
+		.bytes = cache.bytes,
+	};
+}
+
+void Image::ClearShared() {
+	TrimShared(0);
+}
+
 QPixmap Image::prepare(int w, int h, const Images::PrepareArgs &args) const {
 	if (_data.isNull()) {
 		if (h <= 0 && height() > 0) {
@@ -24,6 +24,7 @@ public:
 	explicit Image(const QString &path);
 	explicit Image(const QByteArray &content);
 	explicit Image(QImage &&data);
+	~Image();
 
 	[[nodiscard]] static not_null<Image*> Empty(); // 1x1 transparent
 	[[nodiscard]] static not_null<Image*> BlankMedia(); // 1x1 black
@@ -95,7 +96,39 @@ public:
 		return prepare(w, 0, args);
 	}
 
+	// Same as pixNoCache(), but the result is kept in a cache shared by
+	// all the images, limited by memory and evicting the least recently
+	// used pixmaps. For thumbnails prepared again and again by widgets
+	// that are recreated while scrolling.
+	[[nodiscard]] QPixmap pixShared(
+			QSize size,
+			const Images::PrepareArgs &args = {}) const {
+		return shared(size.width(), size.height(), args);
+	}
+	[[nodiscard]] QPixmap pixShared(
+			int w,
+			int h,
+			const Images::PrepareArgs &args = {}) const {
+		return shared(w, h, args);
+	}
+	[[nodiscard]] QPixmap pixShared(
+			int w = 0,
+			const Images::PrepareArgs &args = {}) const {
+		return shared(w, 0, args);
+	}
+
+	struct SharedCacheStatistics {
+		int count = 0;
+		int64 bytes = 0;
+	};
+	[[nodiscard]] static SharedCacheStatistics SharedStatistics();
+	static void ClearShared();
+
 private:
+	[[nodiscard]] QPixmap shared(
+		int w,
+		int h,
+		const Images::PrepareArgs &args) const;
 	[[nodiscard]] QPixmap prepare(
 		int w,
 		int h,
@@ -108,5 +141,6 @@ private:
 
 	const QImage _data;
 	mutable base::flat_map<uint64, QPixmap> _cache;
+	mutable bool _sharedCached = false;
 
 };
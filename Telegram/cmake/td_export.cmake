@@ -13,6 +13,8 @@ nice_target_sources(td_export ${src_loc}
 PRIVATE
     export/export_api_wrap.cpp
     export/export_api_wrap.h
+    export/export_checkpoint.cpp
+    export/export_checkpoint.h
     export/export_controller.cpp
     export/export_controller.h
     export/export_pch.h
@@ -42,4 +44,6 @@ target_link_libraries(td_export
 PUBLIC
     desktop-app::lib_base
     tdesktop::td_scheme
+PRIVATE
+    desktop-app::external_zlib
 )
@@ -5,6 +5,8 @@
 # https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 option(TDESKTOP_API_TEST "Use test API credentials." OFF)
+option(TDESKTOP_DISABLE_TRACING "Remove the tracing instrumentation." OFF)
+option(TDESKTOP_BUILD_BENCHMARKS "Build the headless benchmark tools." OFF)
 set(TDESKTOP_API_ID "0" CACHE STRING "Provide 'api_id' for the Telegram API access.")
 set(TDESKTOP_API_HASH "" CACHE STRING "Provide 'api_hash' for the Telegram API access.")
 
@@ -43,3 +45,7 @@ endif()
 if (DESKTOP_APP_SPECIAL_TARGET)
     target_compile_definitions(Telegram PRIVATE TDESKTOP_ALLOW_CLOSED_ALPHA)
 endif()
+
+if (TDESKTOP_DISABLE_TRACING)
+    target_compile_definitions(Telegram PRIVATE TDESKTOP_DISABLE_TRACING)
+endif()